@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Micro benchmarks for the networking code. Each registers itself before main() runs and prints its own results, the
+//numbers are only meant to compare the approaches side by side on the same machine. Build in Release
+struct BenchCase {
+	const char* m_Name;
+	void (*m_Body)();
+};
+
+inline std::vector<BenchCase>& BenchRegistry() {
+	static std::vector<BenchCase> benches;
+	return benches;
+}
+
+struct BenchRegistrar {
+	BenchRegistrar(const char* name, void (*body)()) {
+		BenchRegistry().push_back({ name, body });
+	}
+};
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static BenchRegistrar name##Registrar(#name, name); \
+	static void name()
+
+//Average time one of operations took while running body
+template<typename Body>
+double NanosPerOp(size_t operations, Body&& body) {
+	auto start = std::chrono::steady_clock::now();
+	body();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / static_cast<double>(operations);
+}
+
+inline void PrintResult(const std::string& label, double value, const char* unit) {
+	std::cout << "\t" << std::left << std::setw(48) << label << std::right << std::fixed << std::setprecision(1) << std::setw(10) << value << " " << unit << std::endl;
+}
\ No newline at end of file
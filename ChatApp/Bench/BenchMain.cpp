@@ -0,0 +1,18 @@
+#include "Bench.h"
+#include <algorithm>
+
+//Runs every registered benchmark, or only the ones named on the command line
+int main(int argc, char* argv[]) {
+	std::vector<std::string> selected(argv + 1, argv + argc);
+
+	for (const BenchCase& bench : BenchRegistry()) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), bench.m_Name) == selected.end()) {
+			continue;
+		}
+
+		std::cout << bench.m_Name << std::endl;
+		bench.m_Body();
+	}
+
+	return 0;
+}
\ No newline at end of file
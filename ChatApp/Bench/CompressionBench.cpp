@@ -0,0 +1,54 @@
+#include "Bench.h"
+#include "../Networking/Compression.h"
+#include <random>
+
+//The online list is the body compression was added for: the same few statuses over and over
+static std::vector<uint8_t> OnlineList(size_t users) {
+	const char* statuses[] = { "Open", "Chatting", "Server" };
+	std::string list;
+	for (size_t i = 0; i < users; i++) {
+		list += "user" + std::to_string(i * 7919 % 100000) + " | " + statuses[i % 3] + "\n";
+	}
+
+	return std::vector<uint8_t>(list.begin(), list.end());
+}
+
+static std::vector<uint8_t> RandomBytes(size_t size) {
+	std::mt19937 rng(1);
+	std::vector<uint8_t> bytes(size);
+	for (uint8_t& byte : bytes) {
+		byte = static_cast<uint8_t>(rng());
+	}
+
+	return bytes;
+}
+
+static void MeasureCodec(const std::string& name, const std::vector<uint8_t>& body) {
+	constexpr size_t ROUNDS = 2000;
+	PacketBody compressed, decompressed;
+
+	double compressNs = NanosPerOp(ROUNDS, [&]() {
+		for (size_t i = 0; i < ROUNDS; i++) {
+			compressed.clear();
+			LZCompress(body.data(), body.size(), compressed);
+		}
+	});
+
+	double decompressNs = NanosPerOp(ROUNDS, [&]() {
+		for (size_t i = 0; i < ROUNDS; i++) {
+			LZDecompress(compressed.data(), compressed.size(), decompressed);
+		}
+	});
+
+	double megabytes = static_cast<double>(body.size()) / (1024.0 * 1024.0);
+	std::cout << "\t" << name << ": " << body.size() << " -> " << compressed.size() << " bytes" << std::endl;
+	PrintResult(name + " compress", megabytes / (compressNs / 1e9), "MB/s");
+	PrintResult(name + " decompress", megabytes / (decompressNs / 1e9), "MB/s");
+}
+
+//Ratio and speed of the LZ codec on what the server actually sends next to data that doesn't compress at all
+BENCHMARK(Compression) {
+	MeasureCodec("online list, 50 users", OnlineList(50));
+	MeasureCodec("online list, 1000 users", OnlineList(1000));
+	MeasureCodec("random bytes, 16KB", RandomBytes(16 * 1024));
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "Bench.h"
+#include "../Networking/TSQueue.h"
+#include "../Networking/MPMCQueue.h"
+
+//Producers push while one consumer keeps taking everything queued, the way IncomingPacketQueue is drained
+template<typename Queue>
+static double PopAllNanos(size_t producers, size_t perProducer) {
+	Queue queue;
+
+	return NanosPerOp(producers * perProducer, [&]() {
+		std::vector<std::thread> threads;
+		for (size_t p = 0; p < producers; p++) {
+			threads.emplace_back([&]() {
+				for (size_t i = 0; i < perProducer; i++) {
+					queue.PushBack(static_cast<int>(i));
+				}
+			});
+		}
+
+		std::deque<int> drained;
+		for (size_t taken = 0; taken < producers * perProducer; taken += drained.size()) {
+			drained.clear();
+			queue.PopAll(drained);
+
+			if (drained.empty()) {
+				std::this_thread::yield();
+			}
+		}
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	});
+}
+
+//The mutex around a deque against the lock free ring, with the same total number of items however many push them
+BENCHMARK(MPMCQueueContended) {
+	constexpr size_t ITEMS = 400000;
+
+	for (size_t producers : { 1, 4, 16, 64 }) {
+		double locked = PopAllNanos<TSQueue<int>>(producers, ITEMS / producers);
+		double lockFree = PopAllNanos<MPMCQueue<int>>(producers, ITEMS / producers);
+
+		PrintResult(std::to_string(producers) + " producers, TSQueue", locked, "ns/item");
+		PrintResult(std::to_string(producers) + " producers, MPMCQueue", lockFree, "ns/item");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "Bench.h"
+#include "../Networking/Packet.h"
+#include "../Networking/RingQueue.h"
+#include "../Networking/MPSCQueue.h"
+#include <deque>
+#include <thread>
+
+//What the outgoing queue used to be: every call on the write path took the queue's lock on its own
+template<typename T>
+class PerCallLockedQueue {
+public:
+	void PushBack(T&& data) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(data));
+	}
+
+	T PopFront() {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		T front = std::move(m_Queue.front());
+		m_Queue.pop_front();
+		return front;
+	}
+
+	const T& At(size_t index) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Queue[index];
+	}
+
+	bool isEmpty() {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Queue.empty();
+	}
+
+	size_t count() {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Queue.size();
+	}
+
+private:
+	std::mutex m_Mutex;
+	std::deque<T> m_Queue;
+};
+
+//The calls one packet costs between Send() and the end of its write: the empty check that decides whether to start
+//writing, the push, the peek WritePackets does and the pop once it's written
+BENCHMARK(OutgoingQueue) {
+	constexpr size_t PACKETS = 2000000;
+	SharedPacket shared = std::make_shared<const Packet>(PacketType::Message);
+
+	PerCallLockedQueue<SharedPacket> locked;
+	double lockedNs = NanosPerOp(PACKETS, [&]() {
+		for (size_t i = 0; i < PACKETS; i++) {
+			bool writing = !locked.isEmpty();
+			locked.PushBack(SharedPacket(shared));
+			(void)locked.At(locked.count() - 1);
+			locked.PopFront();
+			(void)writing;
+		}
+	});
+
+	MPSCQueue<SharedPacket> handoff;
+	RingQueue<SharedPacket> ring;
+	double ringNs = NanosPerOp(PACKETS, [&]() {
+		SharedPacket packet;
+		for (size_t i = 0; i < PACKETS; i++) {
+			handoff.Push(SharedPacket(shared));
+			handoff.Pop(packet);
+
+			bool writing = !ring.isEmpty();
+			ring.PushBack(std::move(packet));
+			(void)ring.At(ring.count() - 1);
+			ring.PopFront();
+			(void)writing;
+		}
+	});
+
+	PrintResult("queue locked per call", lockedNs, "ns/packet");
+	PrintResult("send handoff + ring", ringNs, "ns/packet");
+}
+
+//Several threads sending to one connection at once while the context drains, the case the lock free handoff is for
+BENCHMARK(OutgoingQueueContended) {
+	constexpr size_t PACKETS = 1000000;
+	SharedPacket shared = std::make_shared<const Packet>(PacketType::Message);
+
+	for (size_t senders : { 1, 2, 4, 8 }) {
+		size_t perSender = PACKETS / senders;
+
+		PerCallLockedQueue<SharedPacket> locked;
+		double lockedNs = NanosPerOp(perSender * senders, [&]() {
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < senders; t++) {
+				threads.emplace_back([&]() {
+					for (size_t i = 0; i < perSender; i++) {
+						locked.PushBack(SharedPacket(shared));
+					}
+				});
+			}
+
+			for (size_t drained = 0; drained < perSender * senders;) {
+				if (!locked.isEmpty()) {
+					locked.PopFront();
+					drained++;
+				}
+			}
+
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		});
+
+		MPSCQueue<SharedPacket> handoff;
+		double handoffNs = NanosPerOp(perSender * senders, [&]() {
+			std::vector<std::thread> threads;
+			for (size_t t = 0; t < senders; t++) {
+				threads.emplace_back([&]() {
+					for (size_t i = 0; i < perSender; i++) {
+						handoff.Push(SharedPacket(shared));
+					}
+				});
+			}
+
+			SharedPacket packet;
+			for (size_t drained = 0; drained < perSender * senders;) {
+				if (handoff.Pop(packet)) {
+					drained++;
+				}
+			}
+
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		});
+
+		PrintResult(std::to_string(senders) + " senders, queue locked per call", lockedNs, "ns/packet");
+		PrintResult(std::to_string(senders) + " senders, send handoff", handoffNs, "ns/packet");
+	}
+}
\ No newline at end of file
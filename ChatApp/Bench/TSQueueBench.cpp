@@ -0,0 +1,54 @@
+#include "Bench.h"
+#include "../Networking/TSQueue.h"
+
+//Producers push while one consumer drains, like the connections feeding Server::Update
+template<typename Drain>
+double DrainNanos(size_t producers, size_t perProducer, Drain&& drain) {
+	TSQueue<int> queue;
+
+	return NanosPerOp(producers * perProducer, [&]() {
+		std::vector<std::thread> threads;
+		for (size_t p = 0; p < producers; p++) {
+			threads.emplace_back([&]() {
+				for (size_t i = 0; i < perProducer; i++) {
+					queue.PushBack(static_cast<int>(i));
+				}
+			});
+		}
+
+		for (size_t drained = 0; drained < producers * perProducer;) {
+			drained += drain(queue);
+		}
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	});
+}
+
+//Taking the backlog one lock at a time against swapping all of it out in one
+BENCHMARK(TSQueueDrain) {
+	constexpr size_t ITEMS = 200000;
+
+	for (size_t producers : { 1, 2, 4, 8, 16 }) {
+		double oneAtATime = DrainNanos(producers, ITEMS, [](TSQueue<int>& queue) {
+			size_t taken = 0;
+			int item;
+			while (queue.TryPopFront(item)) {
+				taken++;
+			}
+
+			return taken;
+		});
+
+		std::deque<int> drained;
+		double swapped = DrainNanos(producers, ITEMS, [&drained](TSQueue<int>& queue) {
+			drained.clear();
+			queue.PopAll(drained);
+			return drained.size();
+		});
+
+		PrintResult(std::to_string(producers) + " producers, TryPopFront", oneAtATime, "ns/item");
+		PrintResult(std::to_string(producers) + " producers, PopAll", swapped, "ns/item");
+	}
+}
\ No newline at end of file
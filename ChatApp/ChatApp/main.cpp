@@ -10,6 +10,7 @@ void MessagePartner(std::string& input);
 void ProcessPackets();
 void ProcessPendingRequest(std::string& input);
 void SendMsg(const std::string& message);
+void PrintPresence();
 int NumberShift(int numI);
 std::string GatherInput();
 BOOL WINAPI ConsoleHandle(DWORD cEvent);
@@ -122,15 +123,22 @@ std::string GatherInput() {
 }
 
 void SendMsg(const std::string& message) {
-	Packet msg(PacketType::Message);
-	msg << std::string(g_Client->getAccount().m_AccUser + ":" + message);
-	g_Client->Send(msg);
+	UserID partner = g_Client->FindUserID(g_Client->m_ChattingWith);
+
+	if ((g_Client->getFeatures() & FEATURE_USER_IDS) && partner != UserID::None) {
+		g_Client->Send(EncodeMessage(UserChatMsg{ partner, message }));
+	}
+	else {
+		g_Client->Send(EncodeMessage(ChatMsg{ g_Client->getAccount().m_AccUser, message }));
+	}
+
 	std::cout << "You: " << message << std::endl;
 }
 
 void ProcessPackets() {
-	if (!g_Client->Incoming().isEmpty()) {
-		Packet packet = g_Client->Incoming().PopFront().m_Packet;
+	OwnedPacket incoming;
+	if (g_Client->Incoming().TryPopFront(incoming)) {
+		Packet& packet = incoming.m_Packet;
 
 		switch (packet.m_Header.m_ID) {
 			case PacketType::ServerAccept: {
@@ -142,16 +150,16 @@ void ProcessPackets() {
 
 			case PacketType::ServerReject: {
 				g_Client->m_AccountProcessed = false;
-				int reason;
-				packet >> reason;
-				std::cout << "You Have Been Rejected! Reason: " << g_RejectionReasons[reason] << std::endl;
+				ServerRejectMsg reject;
+				DecodeMessage(packet, reject);
+				std::cout << "You Have Been Rejected! Reason: " << g_RejectionReasons[reject.m_Reason] << std::endl;
 				break;
 			}
 
 			case PacketType::OnlineList: {
-				std::string list;
-				packet >> list;
-				std::cout << std::endl << "Users Online:" << std::endl << list;
+				OnlineListMsg onlineList;
+				DecodeMessage(packet, onlineList);
+				std::cout << std::endl << "Users Online:" << std::endl << onlineList.m_List;
 
 				if (g_Client->m_AwaitingRequest.empty() && !g_Client->m_Chatting) {
 					std::cout << "Enter The User You Want To Talk To" << std::endl;
@@ -159,34 +167,80 @@ void ProcessPackets() {
 				break;
 			}
 
+			case PacketType::PresenceSnapshot: {
+				PresenceSnapshotMsg snapshot;
+				DecodeMessage(packet, snapshot);
+				g_Client->ApplyPresenceSnapshot(snapshot);
+				PrintPresence();
+				break;
+			}
+
+			case PacketType::PresenceDelta: {
+				PresenceDeltaMsg delta;
+				PresenceEntry user;
+				DecodeMessage(packet, delta);
+
+				if (g_Client->ApplyPresenceDelta(delta, user) && user.m_User != g_Client->getAccount().m_AccUser) {
+					switch (static_cast<PresenceChange>(delta.m_Change)) {
+						case PresenceChange::Join:
+							std::cout << user.m_User << " is Now Online" << std::endl;
+							break;
+
+						case PresenceChange::Leave:
+							std::cout << user.m_User << " Has Gone Offline" << std::endl;
+							break;
+
+						default:
+							std::cout << user.m_User << " is Now " << StatusTranslator(user.m_Status) << std::endl;
+							break;
+					}
+				}
+				break;
+			}
+
 			case PacketType::Message: {
-				std::string msg;
-				packet >> msg;
+				ChatMsg msg;
+				DecodeMessage(packet, msg);
 
-				std::cout << g_Client->m_ChattingWith << ": " << msg << std::endl;
+				std::cout << g_Client->m_ChattingWith << ": " << msg.m_Text << std::endl;
+				break;
+			}
+
+			case PacketType::UserMessage: {
+				UserChatMsg msg;
+				DecodeMessage(packet, msg);
+
+				std::cout << g_Client->m_ChattingWith << ": " << msg.m_Text << std::endl;
+				break;
+			}
+
+			case PacketType::UserInfo: {
+				UserInfoMsg info;
+				DecodeMessage(packet, info);
+				g_Client->m_UserIDs[std::string(info.m_User)] = info.m_ID;
 				break;
 			}
 
 			case PacketType::MessageAll: {
-				std::string message;
-				packet >> message;
-				std::cout << "Server [EVERYONE]: " << message << std::endl;
+				MessageAllMsg message;
+				DecodeMessage(packet, message);
+				std::cout << "Server [EVERYONE]: " << message.m_Text << std::endl;
 				break;
 			}
 
 			case PacketType::ServerMessage: {
-				std::string message;
-				packet >> message;
-				std::cout << "Server: " << message << std::endl;
+				ServerMessageMsg message;
+				DecodeMessage(packet, message);
+				std::cout << "Server: " << message.m_Text << std::endl;
 				break;
 			}
 
 			case PacketType::ChatResponse: {
-				std::string response;
-				packet >> response;
+				ChatResponseMsg response;
+				DecodeMessage(packet, response);
 
-				std::string rec = response.substr(0, response.find(":"));
-				int responseCode = std::stoi(response.substr(response.find(":") + 1, 1));
+				std::string rec(response.m_Receiver);
+				int responseCode = response.m_Code;
 
 				if (responseCode == 4) {
 					g_Client->m_Chatting = false;
@@ -204,9 +258,9 @@ void ProcessPackets() {
 			}
 
 			case PacketType::ChatAlert: {
-				std::string userRequesting;
-				packet >> userRequesting;
-				g_Client->m_AwaitingRequest.push_back(userRequesting);
+				ChatAlertMsg alert;
+				DecodeMessage(packet, alert);
+				g_Client->m_AwaitingRequest.push_back(std::string(alert.m_Requester));
 				std::cout << "The User " << g_Client->m_AwaitingRequest.back() << " Wants To Chat With You, Accept? (y/n)" << std::endl;
 				break;
 			}
@@ -220,9 +274,7 @@ void ProcessPackets() {
 										
 			case PacketType::LeaveServer: {
 				std::cout << "You Have Been Kicked From The Sever!" << std::endl;
-				Packet leaveConversation(PacketType::LeaveConvo);
-				leaveConversation << g_Client->getAccount().m_AccUser;
-				g_Client->Send(leaveConversation);
+				g_Client->Send(EncodeMessage(LeaveConvoMsg{ g_Client->getAccount().m_AccUser }));
 				g_Client->m_Chatting = false;
 				g_Client->Disconnect();
 				break;
@@ -236,6 +288,23 @@ void ProcessPackets() {
 	}
 }
 
+//Same layout as the online list the server sends to clients without FEATURE_PRESENCE
+void PrintPresence() {
+	std::string list = "";
+
+	for (const auto& user : g_Client->getPresence()) {
+		if (user.second.m_User != g_Client->getAccount().m_AccUser) {
+			list += user.second.m_User + " | " + StatusTranslator(user.second.m_Status) + "\n";
+		}
+	}
+
+	std::cout << std::endl << "Users Online:" << std::endl << ((list.empty()) ? "You Are The Only One Online!\n" : list);
+
+	if (g_Client->m_AwaitingRequest.empty() && !g_Client->m_Chatting) {
+		std::cout << "Enter The User You Want To Talk To" << std::endl;
+	}
+}
+
 void ProcessPendingRequest(std::string& input) {
 	if (input != "y" && input != "n") {
 		std::cout << "Invalid Response, Enter 'y' to Accept, 'n' to Reject" << std::endl;
@@ -259,16 +328,12 @@ void ProcessPendingRequest(std::string& input) {
 
 bool ProcessResponses(std::string& input, const std::string& sender) {
 	if (input == "y") {
-		Packet acceptRequest(PacketType::ChatAlertResponse);
-		acceptRequest << std::string(g_Client->getAccount().m_AccUser + ":" + sender + ":t");
-		g_Client->Send(acceptRequest);
+		g_Client->Send(EncodeMessage(ChatAlertResponseMsg{ g_Client->getAccount().m_AccUser, sender, true }));
 		std::cout << "You Are Now Chatting With " << sender << ", Say Hello! Enter \"!leave\" to Exit the Conversation" << std::endl;
 		return true;
 	}
 	else {
-		Packet rejectRequest(PacketType::ChatAlertResponse);
-		rejectRequest << std::string(g_Client->getAccount().m_AccUser + ":" + sender + ":f");
-		g_Client->Send(rejectRequest);
+		g_Client->Send(EncodeMessage(ChatAlertResponseMsg{ g_Client->getAccount().m_AccUser, sender, false }));
 		return false;
 	}
 }
@@ -286,17 +351,13 @@ void SendChatRequest(std::string& input) {
 			newPassword = GatherInput();
 
 			std::cout << "New Password is Now: " << newPassword << std::endl;
-			Packet chgPass(PacketType::ChangePassword);
-			chgPass << std::string(g_Client->getAccount().m_AccUser + "#" + newPassword);
-			g_Client->Send(chgPass);
+			g_Client->Send(EncodeMessage(ChangePasswordMsg{ g_Client->getAccount().m_AccUser, newPassword }));
 		}
 		else {
 			std::cout << "The Password: " << oldPasswordGuess << " is Incorrect!" << std::endl;
 		}
 	}else if (input != g_Client->getAccount().m_AccUser) {
-		Packet requestPacket(PacketType::ChatRequest);
-		requestPacket << input;
-		g_Client->Send(requestPacket);
+		g_Client->Send(EncodeMessage(ChatRequestMsg{ input }));
 		std::cout << "Chatting Request Sent To " << input << std::endl;
 	}
 	else {
@@ -308,9 +369,7 @@ void MessagePartner(std::string& input) {
 	if (input == "!leave") {
 		std::cout << "You Have Left the Conversation With " << g_Client->m_ChattingWith << std::endl;
 
-		Packet leavePacket(PacketType::LeaveConvo);
-		leavePacket << g_Client->getAccount().m_AccUser;
-		g_Client->Send(leavePacket);
+		g_Client->Send(EncodeMessage(LeaveConvoMsg{ g_Client->getAccount().m_AccUser }));
 		g_Client->m_ChattingWith = "";
 		g_Client->m_Chatting = false;
 	}
@@ -430,8 +489,7 @@ bool ProcessChatResponse(int responseCode, const std::string& receiver) {
 BOOL WINAPI ConsoleHandle(DWORD cEvent) {
 	if (cEvent == CTRL_CLOSE_EVENT && g_Client != nullptr && g_Client->isConnected()) {
 		if (g_Client->m_Accepted) {
-			Packet leaving(PacketType::ClientExit);
-			g_Client->Send(leaving);
+			g_Client->Send(EncodeMessage(ClientExitMsg{}));
 			g_Client->m_ChattingWith = "";
 			g_Client->m_Chatting = false;
 		}
@@ -0,0 +1,67 @@
+#pragma once
+#include "WireHeader.h"
+
+//A Batch packet carries several small packets in one frame, so a burst to the same socket (ServerAccept followed by
+//OnlineList, a run of chat messages) costs one header and one write. The body is the packets back to back, each as a
+//compact header (1 byte type + varint size) followed by its body. Only sent to connections that agreed on
+//FEATURE_BATCHING and never nested
+constexpr size_t MAX_BATCH_ENTRY_SIZE = 256; //Larger bodies go out in their own frame, copying them gains nothing
+constexpr size_t MAX_BATCH_SIZE = 8 * 1024;
+constexpr size_t MAX_BATCH_ENTRIES = 64; //The receiver counts each one against its in flight cap
+
+inline bool CanBatch(const Packet& packet) {
+	return packet.m_Body.size() <= MAX_BATCH_ENTRY_SIZE && packet.m_Header.m_ID != PacketType::Batch;
+}
+
+inline void AppendToBatch(PacketBody& batch, const Packet& packet) {
+	PacketHeader entry = packet.m_Header;
+	entry.m_Size = static_cast<uint32_t>(packet.m_Body.size());
+	entry.m_Flags = 0;
+
+	uint8_t header[MAX_HEADER_SIZE];
+	batch.append(header, EncodeHeader(HeaderFormat::Compact, entry, header));
+	batch.append(packet.m_Body.data(), packet.m_Body.size());
+}
+
+//Walks the entries without copying them, onEntry gets each header and a pointer to its body. False at the first entry
+//that's malformed, over MAX_BATCH_ENTRY_SIZE, past MAX_BATCH_ENTRIES or of a type that never comes off the wire
+template<typename Func>
+bool ForEachBatchEntry(const PacketBody& batch, Func&& onEntry) {
+	size_t offset = 0;
+	size_t entries = 0;
+
+	while (offset < batch.size()) {
+		PacketHeader header;
+		size_t headerLength = 0;
+		if (++entries > MAX_BATCH_ENTRIES || DecodeHeader(HeaderFormat::Compact, batch.data() + offset, batch.size() - offset, header, headerLength) != HeaderResult::Complete) {
+			return false;
+		}
+
+		offset += headerLength;
+		//Backpressure is only ever made by the connection itself, a peer sending one is forging it, batched or not
+		if (header.m_Flags != 0 || header.m_ID == PacketType::Batch || header.m_ID == PacketType::Backpressure || header.m_Size > MAX_BATCH_ENTRY_SIZE || header.m_Size > batch.size() - offset) {
+			return false;
+		}
+
+		onEntry(header, batch.data() + offset);
+		offset += header.m_Size;
+	}
+
+	return true;
+}
+
+//Hands every packet in the batch to onPacket in the order they were sent. Returns false if the batch is malformed, is
+//over the limits every sender keeps to or holds a type that never comes off the wire. Nothing is handed over then
+template<typename Func>
+bool UnpackBatch(const PacketBody& batch, Func&& onPacket) {
+	if (batch.size() > MAX_BATCH_SIZE || !ForEachBatchEntry(batch, [](const PacketHeader&, const uint8_t*) {})) {
+		return false;
+	}
+
+	return ForEachBatchEntry(batch, [&onPacket](const PacketHeader& header, const uint8_t* body) {
+		Packet packet(header.m_ID);
+		packet.m_Header = header;
+		packet.m_Body.assign(body, header.m_Size);
+		onPacket(std::move(packet));
+	});
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+#include "NetIncludes.h"
+#include <atomic>
+
+struct BufferPoolStats {
+	uint64_t m_Hits = 0; //Requests served from a free list
+	uint64_t m_Misses = 0; //Requests that had to allocate a new block
+	uint64_t m_Oversized = 0; //Requests bigger than the largest size class, never pooled
+	uint64_t m_Freed = 0; //Blocks handed back to the system because the pool was already full
+};
+
+//Pool of recycled body buffers. Blocks are grouped in power of two size classes, each thread keeps a small
+//free list per class so the common acquire / release pair never takes a lock. Threads only touch the shared
+//lists in batches, when their own list runs dry or overflows
+class BufferPool {
+public:
+	static constexpr size_t SMALLEST_CLASS = 256;
+	static constexpr size_t CLASS_COUNT = 9; //256 bytes up to 64KB
+	static constexpr size_t THREAD_CACHE_LIMIT = 32; //Blocks per class a thread keeps for itself
+	static constexpr size_t SHARED_LIMIT = 256; //Blocks per class kept in the shared lists
+
+	//Never destroyed, packets that outlive main() can still give their buffers back safely
+	static BufferPool& Get() {
+		static BufferPool* pool = new BufferPool();
+		return *pool;
+	}
+
+	//Capacity is set to the real size of the block, which can be larger than what was asked for
+	void* Acquire(size_t bytes, size_t& capacity) {
+		size_t sizeClass = ClassOf(bytes);
+
+		if (sizeClass == CLASS_COUNT) {
+			m_Oversized.fetch_add(1, std::memory_order_relaxed);
+			capacity = bytes;
+			return ::operator new(bytes);
+		}
+
+		capacity = ClassSize(sizeClass);
+		ThreadCache* cache = LocalCache();
+
+		if (cache) {
+			std::vector<void*>& freeList = cache->m_Free[sizeClass];
+			if (freeList.empty()) {
+				Refill(freeList, sizeClass);
+			}
+
+			if (!freeList.empty()) {
+				void* block = freeList.back();
+				freeList.pop_back();
+				m_Hits.fetch_add(1, std::memory_order_relaxed);
+				return block;
+			}
+		}
+		else { //Thread is shutting down, go straight to the shared lists
+			std::lock_guard<std::mutex> lock(m_SharedMutex);
+			if (!m_Shared[sizeClass].empty()) {
+				void* block = m_Shared[sizeClass].back();
+				m_Shared[sizeClass].pop_back();
+				m_Hits.fetch_add(1, std::memory_order_relaxed);
+				return block;
+			}
+		}
+
+		m_Misses.fetch_add(1, std::memory_order_relaxed);
+		return ::operator new(capacity);
+	}
+
+	void Release(void* block, size_t capacity) {
+		size_t sizeClass = ClassOf(capacity);
+
+		if (sizeClass == CLASS_COUNT || ClassSize(sizeClass) != capacity) { //Not one of ours
+			::operator delete(block);
+			return;
+		}
+
+		ThreadCache* cache = LocalCache();
+		if (cache) {
+			std::vector<void*>& freeList = cache->m_Free[sizeClass];
+			freeList.push_back(block);
+
+			if (freeList.size() > THREAD_CACHE_LIMIT) {
+				Spill(freeList, sizeClass, THREAD_CACHE_LIMIT / 2);
+			}
+		}
+		else {
+			std::lock_guard<std::mutex> lock(m_SharedMutex);
+			PushShared(block, sizeClass);
+		}
+	}
+
+	BufferPoolStats getStats() const {
+		BufferPoolStats stats;
+		stats.m_Hits = m_Hits.load(std::memory_order_relaxed);
+		stats.m_Misses = m_Misses.load(std::memory_order_relaxed);
+		stats.m_Oversized = m_Oversized.load(std::memory_order_relaxed);
+		stats.m_Freed = m_Freed.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	static size_t ClassSize(size_t sizeClass) {
+		return SMALLEST_CLASS << sizeClass;
+	}
+
+	//Smallest class that fits the amount of bytes, CLASS_COUNT if none do
+	static size_t ClassOf(size_t bytes) {
+		size_t sizeClass = 0;
+		while (sizeClass < CLASS_COUNT && ClassSize(sizeClass) < bytes) {
+			sizeClass++;
+		}
+
+		return sizeClass;
+	}
+
+private:
+	struct ThreadCache {
+		~ThreadCache() {
+			CacheDestroyed() = true;
+
+			for (size_t i = 0; i < CLASS_COUNT; i++) {
+				BufferPool::Get().Spill(m_Free[i], i, 0);
+			}
+		}
+
+		std::vector<void*> m_Free[CLASS_COUNT];
+	};
+
+	BufferPool() = default;
+
+	//Plain bool so it stays readable after the thread's cache has been torn down
+	static bool& CacheDestroyed() {
+		thread_local bool destroyed = false;
+		return destroyed;
+	}
+
+	static ThreadCache* LocalCache() {
+		if (CacheDestroyed()) {
+			return nullptr;
+		}
+
+		thread_local ThreadCache cache;
+		return &cache;
+	}
+
+	//Take up to half a thread cache worth of blocks from the shared list
+	void Refill(std::vector<void*>& freeList, size_t sizeClass) {
+		std::lock_guard<std::mutex> lock(m_SharedMutex);
+		std::vector<void*>& shared = m_Shared[sizeClass];
+
+		size_t count = std::min(shared.size(), THREAD_CACHE_LIMIT / 2);
+		freeList.insert(freeList.end(), shared.end() - count, shared.end());
+		shared.resize(shared.size() - count);
+	}
+
+	//Move blocks from a thread's list to the shared list until the thread only keeps `keep` of them
+	void Spill(std::vector<void*>& freeList, size_t sizeClass, size_t keep) {
+		std::lock_guard<std::mutex> lock(m_SharedMutex);
+
+		while (freeList.size() > keep) {
+			PushShared(freeList.back(), sizeClass);
+			freeList.pop_back();
+		}
+	}
+
+	void PushShared(void* block, size_t sizeClass) {
+		if (m_Shared[sizeClass].size() < SHARED_LIMIT) {
+			m_Shared[sizeClass].push_back(block);
+		}
+		else {
+			m_Freed.fetch_add(1, std::memory_order_relaxed);
+			::operator delete(block);
+		}
+	}
+
+	std::mutex m_SharedMutex;
+	std::vector<void*> m_Shared[CLASS_COUNT];
+
+	std::atomic<uint64_t> m_Hits{ 0 };
+	std::atomic<uint64_t> m_Misses{ 0 };
+	std::atomic<uint64_t> m_Oversized{ 0 };
+	std::atomic<uint64_t> m_Freed{ 0 };
+};
\ No newline at end of file
@@ -1,4 +1,10 @@
 #include "Connection.h"
+#include <unordered_map>
+
+struct PresenceEntry { //A user in the client's presence table
+	std::string m_User;
+	ChatStatus m_Status = ChatStatus::Open;
+};
 
 class Client {
 public:
@@ -50,6 +56,12 @@ public:
 		}
 	}
 
+	void Send(Packet&& packet) {
+		if (isConnected()) {
+			m_Connection->Send(std::move(packet));
+		}
+	}
+
 	bool isConnected() {
 		if (m_Connection) {
 			return m_Connection->isConnected();
@@ -60,7 +72,7 @@ public:
 	}
 
 	//Retrive any incoming messages
-	TSQueue<OwnedPacket>& Incoming() {
+	IncomingPacketQueue& Incoming() {
 		return m_IncomingMessages;
 	}
 
@@ -68,7 +80,82 @@ public:
 		return m_ClientAccount;
 	}
 
+	inline uint32_t getFeatures() const { //Agreed with the server, 0 until the handshake is done
+		return (m_Connection) ? m_Connection->getFeatures() : 0;
+	}
+
+	//UserID::None if the server hasn't said which ID the user goes by
+	UserID FindUserID(const std::string& username) const {
+		auto user = m_UserIDs.find(username);
+		return (user != m_UserIDs.end()) ? user->second : UserID::None;
+	}
+
+	//Replaces the table with the one the server sent, deltas from then on build on its version
+	void ApplyPresenceSnapshot(const PresenceSnapshotMsg& snapshot) {
+		m_Presence.clear();
+		m_UserIDs.clear(); //Users missing from the snapshot are gone, along with their IDs
+
+		for (const PresenceRecord& record : snapshot.m_Users) {
+			m_Presence[record.m_ID] = { std::string(record.m_User), static_cast<ChatStatus>(record.m_Status) };
+			m_UserIDs[m_Presence[record.m_ID].m_User] = record.m_ID;
+		}
+
+		m_PresenceVersion = snapshot.m_Version;
+		m_PresenceSynced = true;
+	}
+
+	//Changed is the user's entry after the change, or just before it for a leave. False if nothing was applied: the
+	//delta is older than the table, it's for a user the table doesn't have or the one before it went missing, in
+	//which case a new snapshot has been asked for and deltas are ignored until it comes
+	bool ApplyPresenceDelta(const PresenceDeltaMsg& delta, PresenceEntry& changed) {
+		if (!m_PresenceSynced || delta.m_Version <= m_PresenceVersion) {
+			return false;
+		}
+
+		if (delta.m_Version != m_PresenceVersion + 1) {
+			m_PresenceSynced = false;
+			Send(EncodeMessage(PresenceResyncMsg{}));
+			return false;
+		}
+
+		m_PresenceVersion = delta.m_Version;
+		const PresenceRecord& record = delta.m_Record;
+
+		if (static_cast<PresenceChange>(delta.m_Change) == PresenceChange::Join) {
+			m_Presence[record.m_ID] = { std::string(record.m_User), static_cast<ChatStatus>(record.m_Status) };
+			m_UserIDs[m_Presence[record.m_ID].m_User] = record.m_ID;
+			changed = m_Presence[record.m_ID];
+			return true;
+		}
+
+		auto user = m_Presence.find(record.m_ID);
+		if (user == m_Presence.end()) {
+			return false;
+		}
+
+		if (static_cast<PresenceChange>(delta.m_Change) == PresenceChange::Leave) {
+			changed = user->second;
+			m_UserIDs.erase(user->second.m_User);
+			m_Presence.erase(user);
+		}
+		else {
+			user->second.m_Status = static_cast<ChatStatus>(record.m_Status);
+			changed = user->second;
+		}
+
+		return true;
+	}
+
+	inline const std::unordered_map<UserID, PresenceEntry>& getPresence() const { //Everyone online, this client included
+		return m_Presence;
+	}
+
+	inline bool isPresenceSynced() const {
+		return m_PresenceSynced;
+	}
+
 	std::string m_ChattingWith = "";
+	std::unordered_map<std::string, UserID> m_UserIDs; //Filled in from UserInfo and presence packets
 	std::vector<std::string> m_AwaitingRequest; //Waiting for a response by users requesting to chat with this client
 	bool m_Chatting = false, m_AccountProcessed = true, m_Accepted = false;
 
@@ -77,6 +164,11 @@ private:
 	std::thread m_ContextThread;
 	std::unique_ptr<Connection> m_Connection; //Connection to the server
 
-	TSQueue<OwnedPacket> m_IncomingMessages;
+	//Who's online, kept up to date from presence deltas when the server has FEATURE_PRESENCE
+	std::unordered_map<UserID, PresenceEntry> m_Presence;
+	uint32_t m_PresenceVersion = 0;
+	bool m_PresenceSynced = false; //Have a snapshot and haven't missed a delta since
+
+	IncomingPacketQueue m_IncomingMessages;
 	Account m_ClientAccount;
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include "Packet.h"
+#include "WireFormat.h"
+
+//Small LZ77 codec for large bodies like the online list, no outside library needed.
+//A compressed body is the original size as a varint followed by a run of sequences:
+//	token: high 4 bits literal count, low 4 bits match length - 4 (15 means more length bytes follow)
+//	extra literal count bytes, the literals, 2 byte little endian match offset, extra match length bytes
+//The last sequence stops after its literals
+constexpr size_t COMPRESSION_THRESHOLD = 512; //Bodies smaller than this aren't worth compressing
+constexpr size_t MAX_DECOMPRESSED_SIZE = 16 * 1024 * 1024;
+constexpr size_t LZ_MIN_MATCH = 4;
+constexpr size_t LZ_MAX_OFFSET = 65535;
+constexpr size_t LZ_HASH_BITS = 12;
+
+inline uint32_t LZHash(const uint8_t* data) {
+	uint32_t value = static_cast<uint32_t>(ReadLE(data, 4));
+	return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+//Lengths of 15 and up spill into extra bytes, each 255 means another byte follows
+template<typename Buffer>
+void WriteLZLength(Buffer& out, size_t length) {
+	while (length >= 255) {
+		out.push_back(255);
+		length -= 255;
+	}
+
+	out.push_back(static_cast<uint8_t>(length));
+}
+
+inline bool ReadLZLength(const uint8_t* data, size_t size, size_t& offset, size_t& length) {
+	uint8_t byte;
+	do {
+		if (offset >= size || length > MAX_DECOMPRESSED_SIZE) {
+			return false;
+		}
+
+		byte = data[offset++];
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+template<typename Buffer>
+void WriteLZSequence(Buffer& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+	size_t matchCode = (matchLength >= LZ_MIN_MATCH) ? matchLength - LZ_MIN_MATCH : 0;
+	out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+
+	if (literalCount >= 15) {
+		WriteLZLength(out, literalCount - 15);
+	}
+
+	out.append(literals, literalCount);
+
+	if (matchLength >= LZ_MIN_MATCH) {
+		WriteLE(out, offset, 2);
+
+		if (matchCode >= 15) {
+			WriteLZLength(out, matchCode - 15);
+		}
+	}
+}
+
+template<typename Buffer>
+void LZCompress(const uint8_t* data, size_t size, Buffer& out) {
+	WriteVarint(out, size);
+
+	std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0); //Last position + 1 each hash was seen at, 0 if never
+	size_t anchor = 0, pos = 0;
+
+	while (pos + LZ_MIN_MATCH <= size) {
+		uint32_t hash = LZHash(data + pos);
+		size_t candidate = table[hash];
+		table[hash] = static_cast<uint32_t>(pos + 1);
+
+		if (candidate != 0 && pos - (candidate - 1) <= LZ_MAX_OFFSET && std::memcmp(data + candidate - 1, data + pos, LZ_MIN_MATCH) == 0) {
+			size_t match = candidate - 1;
+			size_t length = LZ_MIN_MATCH;
+			while (pos + length < size && data[match + length] == data[pos + length]) {
+				length++;
+			}
+
+			WriteLZSequence(out, data + anchor, pos - anchor, pos - match, length);
+			pos += length;
+			anchor = pos;
+		}
+		else {
+			pos++;
+		}
+	}
+
+	WriteLZSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+//Compressed data comes from the network, every length and offset is checked before it's used. Bodies that would
+//grow past maxSize are rejected before anything is allocated
+template<typename Buffer>
+bool LZDecompress(const uint8_t* data, size_t size, Buffer& out, size_t maxSize = MAX_DECOMPRESSED_SIZE) {
+	size_t in = 0;
+	uint64_t originalSize;
+	if (!ReadVarint(data, size, in, originalSize) || originalSize > maxSize) {
+		return false;
+	}
+
+	out.resize(static_cast<size_t>(originalSize));
+	uint8_t* output = out.data();
+	size_t outSize = out.size(), pos = 0;
+
+	while (in < size) {
+		uint8_t token = data[in++];
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLZLength(data, size, in, literalCount)) {
+			return false;
+		}
+
+		if (literalCount > size - in || literalCount > outSize - pos) {
+			return false;
+		}
+
+		std::memcpy(output + pos, data + in, literalCount);
+		in += literalCount;
+		pos += literalCount;
+
+		if (in == size) { //Last sequence has no match
+			return pos == outSize;
+		}
+
+		if (size - in < 2) {
+			return false;
+		}
+
+		size_t offset = static_cast<size_t>(ReadLE(data + in, 2));
+		in += 2;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLZLength(data, size, in, matchLength)) {
+			return false;
+		}
+		matchLength += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > pos || matchLength > outSize - pos) {
+			return false;
+		}
+
+		//Byte by byte as the match can overlap what it's writing
+		for (size_t i = 0; i < matchLength; i++) {
+			output[pos + i] = output[pos - offset + i];
+		}
+		pos += matchLength;
+	}
+
+	return false;
+}
+
+//Wraps the packet up for sending. When asked to, large bodies get a compressed copy that connections which
+//agreed on compression send instead, made once here so a broadcast doesn't compress per recipient
+inline SharedPacket SharePacket(Packet&& packet, bool compress) {
+	if (compress && packet.m_Body.size() >= COMPRESSION_THRESHOLD) {
+		auto compressed = std::make_shared<PacketBody>();
+		LZCompress(packet.m_Body.data(), packet.m_Body.size(), *compressed);
+
+		//Only keep it if it saves at least an eighth, otherwise the decompression isn't worth it
+		if (compressed->size() <= packet.m_Body.size() - packet.m_Body.size() / 8) {
+			packet.m_CompressedBody = std::move(compressed);
+		}
+	}
+
+	return std::make_shared<const Packet>(std::move(packet));
+}
\ No newline at end of file
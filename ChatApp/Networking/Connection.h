@@ -1,7 +1,25 @@
 #pragma once
 #include "NetIncludes.h"
 #include "TSQueue.h"
-#include "Packet.h"
+#include "RingQueue.h"
+#include "MPSCQueue.h"
+#include "MPMCQueue.h"
+#include "Messages.h"
+#include "LegacyCodec.h"
+#include "WireHeader.h"
+#include "Protocol.h"
+#include "Compression.h"
+#include "Batch.h"
+#include "Crc32c.h"
+#include "Slab.h"
+
+//Queue every connection hands its incoming packets to, drained by the server's dispatcher or the client's main loop.
+//TSQueue by default, build with NET_LOCKFREE_INCOMING defined to use the lock free MPMCQueue instead
+#ifdef NET_LOCKFREE_INCOMING
+using IncomingPacketQueue = MPMCQueue<OwnedPacket>;
+#else
+using IncomingPacketQueue = TSQueue<OwnedPacket>;
+#endif
 
 enum class Owner {
 	Server, Client
@@ -11,6 +29,31 @@ enum class ChatStatus {
 	Server, Chatting, Open
 };
 
+//Just needed to convert the enum to string for the online list
+inline std::string StatusTranslator(ChatStatus status) {
+	std::string str = "";
+
+	switch (status) {
+		case ChatStatus::Server:
+			str = "Server";
+			break;
+		
+		case ChatStatus::Chatting:
+			str = "Chatting";
+			break;
+
+		case ChatStatus::Open: 
+			str = "Open";
+			break;
+
+		default:
+			str = "Unknown";
+			break;
+	}
+
+	return str;
+}
+
 struct Account {
 	void SetInfo(const std::string& username, const std::string& password, int option) {
 		m_AccUser = username;
@@ -22,14 +65,44 @@ struct Account {
 	int m_AccOpt; //Used to know if logging in or signing up
 };
 
+//Limits on a single gathered write. Asio hands at most 64 buffers to one writev call
+constexpr size_t MAX_WRITE_BATCH_BYTES = 64 * 1024;
+constexpr size_t MAX_WRITE_BATCH_BUFFERS = 64;
+//Smallest amount of free space handed to a single read, the read buffer starts at four times this
+constexpr size_t MIN_READ_SIZE = 4 * 1024;
+
+//What to do with a peer that isn't reading fast enough, once its outgoing queue goes over the high watermark
+enum class SlowConsumerPolicy {
+	DropPresence, //Presence updates (the online list) aren't queued until it drains under the low watermark
+	Coalesce, //A new presence update replaces the one still waiting in the queue instead of queuing behind it
+	Disconnect //Closed if it's still over the low watermark once the grace period runs out
+};
+
+inline bool IsPresence(PacketType type) { //Packets that only describe current state, a newer one makes the old one useless
+	return type == PacketType::OnlineList;
+}
+
+//What a connection accepts from its peer and how much it buffers for it, the server hands its limits to every
+//connection it accepts
+struct ConnectionLimits {
+	size_t m_MaxFrameSize = 1024 * 1024; //Largest body a frame may carry (after decompression), larger ones close the connection
+	size_t m_MaxInFlight = 256; //Server side only, packets read but not dispatched yet before reads pause. 0 for no cap
+	size_t m_HighWatermark = 4 * 1024 * 1024; //Queued outgoing bytes that make the connection congested
+	size_t m_LowWatermark = 1024 * 1024; //Queued outgoing bytes it has to drain to before it isn't anymore
+	SlowConsumerPolicy m_SlowConsumerPolicy = SlowConsumerPolicy::Coalesce;
+	std::chrono::milliseconds m_GracePeriod = std::chrono::seconds(10); //For SlowConsumerPolicy::Disconnect
+};
+
 class Connection : public std::enable_shared_from_this<Connection> {
 public:
-	Connection(asio::io_context& context, asio::ip::tcp::socket socket, TSQueue<OwnedPacket>& pack, Owner owner = Owner::Server)
+	Connection(asio::io_context& context, asio::ip::tcp::socket socket, IncomingPacketQueue& pack, Owner owner = Owner::Server)
 		:m_AsioContext(context), m_Socket(std::move(socket)), m_IncomingPackets(pack), m_Owner(owner)
 	{
+		m_Connected = m_Socket.is_open();
+
 		if (m_Owner == Owner::Server) {
 			std::srand(std::time(nullptr));
-			m_HandshakeOut = std::rand() % 264685356;
+			m_HandshakeOut = (std::rand() % 264685356) | HANDSHAKE_HELLO; //Old clients ignore the flag bit
 			m_HandshakeCheck = Rearrange(m_HandshakeOut);
 		}
 	}
@@ -38,14 +111,15 @@ public:
 		if (m_Owner == Owner::Client) {
 			m_Status = ChatStatus::Server;
 			m_Account = acc;
+			m_Connected = true; //Counts as connected while the connect is in progress, like the open socket did
 
-			asio::async_connect(m_Socket, endpoints, [this](std::error_code ec, asio::ip::tcp::endpoint endpoint) {
+			asio::async_connect(m_Socket, endpoints, [this, self = KeepAlive()](std::error_code ec, asio::ip::tcp::endpoint) {
 				if (!ec) {
 					ReadValidation();
 				}
 				else {
 					std::cout << "Failed To Connect To Server: " << ec.message() << std::endl;
-					m_Socket.close();
+					CloseSocket();
 				}
 			});
 		}
@@ -58,30 +132,64 @@ public:
 		}
 	}
 
-	void ConnectToClient(unsigned int index, uint32_t id = 0) {
+	//handle is where the server keeps the connection, see Slab.h
+	void ConnectToClient(SlabHandle handle, uint32_t id = 0) {
 		if (m_Owner == Owner::Server) {
 			if (m_Socket.is_open()) {
 				m_ID = id;
 				m_Status = ChatStatus::Open;
-				m_PermIndex = index;
+				m_Handle = handle;
 				WriteValidation();
 				ReadValidation();
 			}
 		}
 	}
 
+	//Called from the server's dispatch threads. Approval is marked right away so the online list sent next sees it, the
+	//reads start on the socket's strand like every other handler. The strand reads nothing into the pending account
+	//until this is called, so the server has taken it by then
 	void ClientConnectionAction(bool accepted) {
 		if (m_Owner == Owner::Server) {
 			if (accepted) {
 				m_ServerApproved = true;
-				ReadPacketHeader();
-			}
-			else {
-				ReadAccountInfo();
 			}
+
+			asio::post(m_Socket.get_executor(), [this, self = KeepAlive(), accepted]() {
+				if (accepted) {
+					ReadPackets();
+				}
+				else {
+					ReadAccountInfo();
+				}
+			});
 		}
 	}
 
+	void SetLimits(const ConnectionLimits& limits) { //Before ConnectToClient / ConnectToServer
+		m_Limits = limits;
+	}
+
+	//Server side, incoming packets are handed straight to the handler instead of the incoming queue. Called on the
+	//context as each packet is read. Before ConnectToClient
+	void SetPacketHandler(std::function<void(OwnedPacket&&)> handler) {
+		m_PacketHandler = std::move(handler);
+	}
+
+	//The server's dispatcher is done with one of this connection's packets. Once it catches up to half the cap a
+	//paused connection starts reading again
+	void ReleaseInbound() {
+		if (CanResume(m_InFlight.fetch_sub(1) - 1) && m_ReadPaused.exchange(false)) {
+			asio::post(m_Socket.get_executor(), [this, self = KeepAlive()]() {
+				ContinueReading();
+			});
+		}
+	}
+
+	//Server side, moves the account the strand just read into place. Called while handling its AccountInfo packet
+	void TakeAccount() {
+		m_Account = m_PendingAccount;
+	}
+
 	void IgnoreConnection() { //Connection is no longer part of the system, mark it as such
 		m_Account.m_AccUser = "$invalid";
 		m_ID = 0;
@@ -89,246 +197,640 @@ public:
 
 	void Disconnect() {
 		if (isConnected()) {
-			asio::post(m_AsioContext, [this]() {
-				m_Socket.shutdown(asio::ip::tcp::socket::shutdown_both);
-				m_Socket.close(); 
+			asio::post(m_Socket.get_executor(), [this, self = KeepAlive()]() {
+				ForceClose();
 			});
 		}
 	}
 
 	void Send(const Packet& packet) {
-		asio::post(m_AsioContext, [this, packet]() {
-			bool writingPackets = !m_OutgoingPackets.isEmpty();
-			m_OutgoingPackets.PushBack(packet);
+		Send(Packet(packet));
+	}
 
-			if (!writingPackets) {
-				WritePacketHeader();
-			}
-		});
+	//The packet is moved into shared storage, never copied
+	void Send(Packet&& packet) {
+		Send(SharePacket(std::move(packet), (m_Features & FEATURE_COMPRESSION) != 0));
 	}
 
-	bool isConnected() {
-		return m_Socket.is_open();
+	//Only the pointer is queued, so the same packet can be sent to any number of connections without copying it.
+	//Safe from any thread: the packet goes through a lock free handoff and the context drains it, with one post
+	//covering every packet sent while the drain is waiting to run
+	void Send(SharedPacket packet) {
+		m_SendHandoff.Push(std::move(packet));
+
+		if (!m_DrainPosted.exchange(true)) {
+			asio::post(m_Socket.get_executor(), [this, self = KeepAlive()]() {
+				DrainSends();
+			});
+		}
+	}
+
+	bool isConnected() const { //Safe from any thread, unlike asking the socket
+		return m_Connected;
 	}
 
 	inline uint32_t getID() const {
 		return m_ID;
 	}
 
-	inline unsigned int getPermIndex() const { //For server side only
-		return m_PermIndex;
+	inline SlabHandle getHandle() const { //For server side only
+		return m_Handle;
+	}
+
+	void SetUserID(UserID userID) { //For server side only, given once the account is accepted
+		m_UserID = userID;
+	}
+
+	inline UserID getUserID() const {
+		return m_UserID;
 	}
 
 	inline Account getAccount() const {
 		return m_Account;
 	}
 
+	inline HeaderFormat getHeaderFormat() const {
+		return m_HeaderFormat;
+	}
+
+	inline uint16_t getProtocolVersion() const {
+		return m_ProtocolVersion;
+	}
+
+	inline uint32_t getFeatures() const {
+		return m_Features;
+	}
+
+	//Outgoing packets not written yet and the bytes their bodies hold, safe to read from any thread
+	inline size_t getQueuedPackets() const {
+		return m_QueuedPackets;
+	}
+
+	inline size_t getQueuedBytes() const {
+		return m_QueuedBytes;
+	}
+
+	inline bool isCongested() const { //Over the high watermark and not yet drained to the low one
+		return m_Congested;
+	}
+
 	inline bool isApproved() const { //For server side only
 		return m_ServerApproved;
 	}
 
-	ChatStatus m_Status;
+	//Server side, who this connection is chatting with and the name its messages go out under. Only set and read on
+	//the thread handling its packets, so chat messages are routed through it without a lookup. The name is copied when
+	//the conversation starts, since the account can be wiped from another thread while messages are still relayed
+	void SetPartner(std::weak_ptr<Connection> partner, std::string chatName = std::string()) {
+		m_Partner = std::move(partner);
+		m_ChatName = std::move(chatName);
+	}
+
+	inline std::shared_ptr<Connection> getPartner() const {
+		return m_Partner.lock();
+	}
+
+	inline const std::string& getChatName() const {
+		return m_ChatName;
+	}
+
+	std::atomic<ChatStatus> m_Status{ ChatStatus::Open }; //Changed and read by whichever dispatch thread has the connection
 
 private:
-	void ReadPacketHeader() {
-		asio::async_read(m_Socket, asio::buffer(&m_TempPacket.m_Header, sizeof(PacketHeader)), [this](std::error_code ec, size_t length) {
-			//If the body has information as well, process that as well
+	//Read whatever the socket has available into the read buffer, then pull out every complete packet in it
+	void ReadPackets() {
+		//Keep room at the end of the buffer, moving any partial packet to the front once the tail runs short
+		if (m_ReadBuffer.size() - m_ReadEnd < MIN_READ_SIZE && m_ReadStart > 0) {
+			std::memmove(m_ReadBuffer.data(), m_ReadBuffer.data() + m_ReadStart, m_ReadEnd - m_ReadStart);
+			m_ReadEnd -= m_ReadStart;
+			m_ReadStart = 0;
+		}
+
+		if (m_ReadBuffer.size() - m_ReadEnd < MIN_READ_SIZE) {
+			m_ReadBuffer.resize(m_ReadBuffer.size() + std::max(m_ReadBuffer.size(), MIN_READ_SIZE));
+		}
+
+		m_Socket.async_read_some(asio::buffer(m_ReadBuffer.data() + m_ReadEnd, m_ReadBuffer.size() - m_ReadEnd), [this, self = KeepAlive()](std::error_code ec, size_t length) {
 			if (!ec) {
-				if ((static_cast<int>(m_TempPacket.m_Header.m_ID) & 1) == 0) {
-					if (m_TempPacket.m_Header.m_Size > 0) {
-						m_TempPacket.m_StrBody.resize(m_TempPacket.m_Header.m_Size);
-						ReadPacketBodyStr();
-					}
-					else {
-						AddIncomingMessage();
-					}
-				}else if (m_TempPacket.m_Header.m_Size > 0) {
-					m_TempPacket.m_Body.resize(m_TempPacket.m_Header.m_Size);
-					ReadPacketBody();
-				}
-				else {
-					AddIncomingMessage();
-				}
-			}else {
-				std::cout << "ID: " << m_ID << " Failed To Read The Packet Header. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				m_ReadEnd += length;
+				ContinueReading(); //Never stop reading, unless the server needs to catch up
+			}
+			else {
+				std::cout << "ID: " << m_ID << " Failed To Read Packets. Reason Provided: " << ec.message() << std::endl;
+				CloseSocket();
 			}
 		});
 	}
 
-	void ReadPacketBody() {
-		asio::async_read(m_Socket, asio::buffer(m_TempPacket.m_Body.data(), m_TempPacket.m_Body.size()), [this](std::error_code ec, size_t length) {
-			if (!ec) {
-				AddIncomingMessage();
+	//Parse what has been read and keep reading, unless the dispatcher is too far behind. Then reads pause until
+	//ReleaseInbound() resumes them, so a flooding client fills its socket buffer instead of the server's memory
+	void ContinueReading() {
+		if (ParsePackets() && !PauseReads()) {
+			ReadPackets();
+		}
+	}
+
+	//Whether count more packets would go over the in flight cap. Anything fits once the dispatcher has caught up
+	//completely, so a batch holding more packets than the whole cap still gets through
+	inline bool InboundFull(size_t count = 1) const {
+		size_t inFlight = m_InFlight;
+		return m_Owner == Owner::Server && m_Limits.m_MaxInFlight != 0 && inFlight != 0 && inFlight + count > m_Limits.m_MaxInFlight;
+	}
+
+	//Down to half the cap, with room for whatever parsing stopped at
+	inline bool CanResume(size_t inFlight) const {
+		return inFlight <= m_Limits.m_MaxInFlight / 2 && (inFlight == 0 || inFlight + m_InboundNeeded <= m_Limits.m_MaxInFlight);
+	}
+
+	bool PauseReads() {
+		if (!InboundFull(m_InboundNeeded)) {
+			return false;
+		}
+
+		m_ReadPaused = true;
+
+		//The dispatcher may have caught up between the check and the flag being set, in which case nobody else resumes.
+		//What's left in the buffer gets parsed before reading on
+		if (CanResume(m_InFlight) && m_ReadPaused.exchange(false)) {
+			asio::post(m_Socket.get_executor(), [this, self = KeepAlive()]() {
+				ContinueReading();
+			});
+		}
+
+		return true;
+	}
+
+	//Returns false if the stream was corrupt and the connection had to be closed
+	bool ParsePackets() {
+		m_InboundNeeded = 1;
+
+		while (m_ReadEnd > m_ReadStart && !InboundFull()) {
+			PacketHeader header;
+			size_t headerLength = 0;
+			HeaderResult result = DecodeHeader(m_HeaderFormat, m_ReadBuffer.data() + m_ReadStart, m_ReadEnd - m_ReadStart, header, headerLength);
+
+			if (result == HeaderResult::Incomplete) {
+				break;
+			}
+			else if (result == HeaderResult::Invalid) {
+				std::cout << "ID: " << m_ID << " Sent An Invalid Packet Header, Closing The Connection" << std::endl;
+				ForceClose();
+				return false;
+			}
+
+			if (header.m_ID == PacketType::Backpressure) {
+				std::cout << "ID: " << m_ID << " Sent A Packet Only The Server Can Make, Closing The Connection" << std::endl;
+				ForceClose();
+				return false;
+			}
+
+			size_t maxBody = (header.m_ID == PacketType::Batch) ? MAX_BATCH_SIZE : m_Limits.m_MaxFrameSize;
+			if (header.m_Size > maxBody) {
+				std::cout << "ID: " << m_ID << " Sent A " << header.m_Size << " Byte Packet, Over The Limit. Closing The Connection" << std::endl;
+				ForceClose();
+				return false;
+			}
+
+			size_t bodyEnd = headerLength + header.m_Size;
+			size_t packetSize = bodyEnd + ((m_Features & FEATURE_CRC32C) ? CRC_TRAILER_SIZE : 0);
+			if (m_ReadEnd - m_ReadStart < packetSize) {
+				//Packet was split, make sure the rest of it will fit and wait for more bytes
+				if (m_ReadBuffer.size() - m_ReadStart < packetSize) {
+					m_ReadBuffer.resize(m_ReadStart + packetSize);
+				}
+
+				break;
+			}
+
+			//Every packet in a batch counts against the cap, so one is only opened once there's room for the most it can hold
+			if (header.m_ID == PacketType::Batch && InboundFull(MAX_BATCH_ENTRIES)) {
+				m_InboundNeeded = MAX_BATCH_ENTRIES;
+				break;
+			}
+
+			const uint8_t* frame = m_ReadBuffer.data() + m_ReadStart;
+			if ((m_Features & FEATURE_CRC32C) && Crc32c(frame, bodyEnd) != ReadLE(frame + bodyEnd, CRC_TRAILER_SIZE)) {
+				ChecksumFailures()++;
+				std::cout << "ID: " << m_ID << " Sent A Packet That Failed Its Checksum, Closing The Connection" << std::endl;
+				ForceClose();
+				return false;
+			}
+
+			const uint8_t* body = frame + headerLength;
+			Packet packet(header.m_ID);
+			packet.m_Header = header;
+
+			if (header.m_Flags & HEADER_FLAG_COMPRESSED) {
+				if (!(m_Features & FEATURE_COMPRESSION) || !LZDecompress(body, header.m_Size, packet.m_Body, maxBody)) {
+					std::cout << "ID: " << m_ID << " Sent A Corrupt Compressed Packet, Closing The Connection" << std::endl;
+					ForceClose();
+					return false;
+				}
+
+				packet.m_Header.m_Size = static_cast<uint32_t>(packet.m_Body.size());
+				packet.m_Header.m_Flags = 0;
 			}
 			else {
-				std::cout << "ID: " << m_ID << " Failed To Read The Packet Body. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				//The only body allocation the packet gets, from here on it's moved all the way to the handler
+				packet.m_Body.assign(body, header.m_Size);
 			}
-		});
-	}
 
-	void ReadPacketBodyStr() {
-		asio::async_read(m_Socket, asio::buffer(m_TempPacket.m_StrBody.data(), m_TempPacket.m_StrBody.size()), [this](std::error_code ec, size_t length) {
-			if (!ec) {
-				AddIncomingMessage();
+			m_ReadStart += packetSize;
+
+			if (header.m_ID == PacketType::Batch) {
+				bool unpacked = (m_Features & FEATURE_BATCHING) && UnpackBatch(packet.m_Body, [this](Packet&& entry) {
+					AddIncomingMessage(std::move(entry));
+				});
+
+				if (!unpacked) {
+					std::cout << "ID: " << m_ID << " Sent A Malformed Batch, Closing The Connection" << std::endl;
+					ForceClose();
+					return false;
+				}
+			}
+			else if (isLegacy()) { //Only the body layout is translated, a bad one is dropped like an unknown type
+				Packet typed;
+				if (DecodeLegacy(packet, IncomingDirection(), typed)) {
+					AddIncomingMessage(std::move(typed));
+				}
+				else {
+					std::cout << "ID: " << m_ID << " Sent A Packet Version 1 Never Had Or A Malformed One, Type: " << static_cast<int>(header.m_ID) << std::endl;
+				}
 			}
 			else {
-				std::cout << "ID: " << m_ID << " Failed To Read The Packet Body. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				AddIncomingMessage(std::move(packet));
 			}
-		});
+		}
+
+		if (m_ReadStart == m_ReadEnd) { //Everything was consumed, start again from the front
+			m_ReadStart = 0;
+			m_ReadEnd = 0;
+		}
+
+		return true;
+	}
+
+	//Captured by every async handler so a connection the server lets go of lives until its last handler has run. Empty
+	//on the client side, where the Client owns the connection outright and stops its context before letting it go
+	std::shared_ptr<Connection> KeepAlive() {
+		return weak_from_this().lock();
+	}
+
+	//Stop both directions and close without waiting on anything queued. For a stream that can't be trusted past a bad
+	//frame (there's no telling where the next one starts) or a peer that can't keep up
+	void ForceClose() {
+		std::error_code ec;
+		m_Socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+		CloseSocket();
+	}
+
+	//Every close goes through here so isConnected() never has to touch the socket from another thread
+	void CloseSocket() {
+		std::error_code ec;
+		m_Socket.close(ec);
+		m_Connected = false;
 	}
 
 	//After reading outgoing packets, now transfer them over to the incoming queue so they can be read by the client / server
-	void AddIncomingMessage() {
+	void AddIncomingMessage(Packet&& packet) {
 		if (m_Owner == Owner::Server) {
-			m_IncomingPackets.PushBack({ this->shared_from_this(), m_TempPacket });
+			m_InFlight++; //Released by the server once it has handled the packet
+
+			if (m_PacketHandler) {
+				m_PacketHandler({ this->shared_from_this(), std::move(packet) });
+			}
+			else {
+				m_IncomingPackets.PushBack({ this->shared_from_this(), std::move(packet) });
+			}
 		}
 		else { //If the owner is a client we know the packet is coming from the server
-			m_IncomingPackets.PushBack({ nullptr, m_TempPacket });
+			m_IncomingPackets.PushBack({ nullptr, std::move(packet) });
 		}
+	}
+
+	void DrainSends() {
+		//Cleared first so a push that's still half way through posts its own drain instead of getting stranded
+		m_DrainPosted = false;
 
-		ReadPacketHeader(); //Never stop reading!
+		SharedPacket packet;
+		while (m_SendHandoff.Pop(packet)) {
+			QueuePacket(std::move(packet));
+		}
 	}
 
-	void WritePacketHeader() {
-		asio::async_write(m_Socket, asio::buffer(&m_OutgoingPackets.Front().m_Header, sizeof(PacketHeader)), [this](std::error_code ec, size_t length) {
-			if (!ec) {
-				//Check if there is information in the body to be written as well
-				if (m_OutgoingPackets.Front().m_Body.size() > 0) { //Body will only > 0 if its not a string packet
-					WritePacketBody();
-				}else if ((static_cast<int>(m_OutgoingPackets.Front().m_Header.m_ID) & 1) == 0) {
-					if (m_OutgoingPackets.Front().m_StrBody.size() > 0) {
-						WritePacketBodyStr();
-					}
-					else {
-						m_OutgoingPackets.PopFront();
+	//Runs on the context, the only place the outgoing queue and its counters change
+	void QueuePacket(SharedPacket packet) {
+		if (isLegacy()) { //Shared packets are typed, a version 1 peer gets its own copy in the original layout
+			Packet legacy;
+			if (!EncodeLegacy(*packet, OutgoingDirection(), legacy)) {
+				std::cout << "ID: " << m_ID << " Uses Version 1, Which Has No Packet Type " << static_cast<int>(packet->m_Header.m_ID) << ". Not Sending It" << std::endl;
+				return;
+			}
 
-						if (!m_OutgoingPackets.isEmpty()) {
-							WritePacketHeader();
-						}
-					}
-				} else {
-					m_OutgoingPackets.PopFront(); //Done writing it, take it off the list
+			packet = std::make_shared<const Packet>(std::move(legacy));
+		}
 
-					//If it's not done writing all the headers keep writing
-					if (!m_OutgoingPackets.isEmpty()) {
-						WritePacketHeader();
+		if (m_Congested && IsPresence(packet->m_Header.m_ID)) {
+			if (m_Limits.m_SlowConsumerPolicy == SlowConsumerPolicy::DropPresence) {
+				return;
+			}
+			else if (m_Limits.m_SlowConsumerPolicy == SlowConsumerPolicy::Coalesce) {
+				//Drop the older one if it isn't part of the write in progress, the new one goes to the back
+				for (size_t i = m_WriteBatchCount; i < m_OutgoingPackets.count(); i++) {
+					if (m_OutgoingPackets.At(i)->m_Header.m_ID == packet->m_Header.m_ID) {
+						SharedPacket stale = m_OutgoingPackets.Erase(i);
+						m_QueuedBytes -= stale->m_Body.size();
+						m_QueuedPackets--;
+						break;
 					}
 				}
 			}
-			else {
-				std::cout << "ID: " << m_ID << " Failed To Write The Packet Header. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+		}
+
+		bool writingPackets = !m_OutgoingPackets.isEmpty();
+		m_QueuedBytes += packet->m_Body.size();
+		m_QueuedPackets++;
+		m_OutgoingPackets.PushBack(std::move(packet));
+		CheckWatermarks();
+
+		if (!writingPackets) {
+			WritePackets();
+		}
+	}
+
+	void CheckWatermarks() {
+		if (!m_Congested && m_QueuedBytes > m_Limits.m_HighWatermark) {
+			m_Congested = true;
+			NotifyBackpressure();
+
+			if (m_Limits.m_SlowConsumerPolicy == SlowConsumerPolicy::Disconnect) {
+				m_GraceTimer.expires_after(m_Limits.m_GracePeriod);
+				m_GraceTimer.async_wait([this, self = KeepAlive()](std::error_code ec) {
+					if (!ec && m_Congested) {
+						std::cout << "ID: " << m_ID << " Is Still Backed Up After The Grace Period, Disconnecting" << std::endl;
+						ForceClose();
+					}
+				});
 			}
-		});
+		}
+		else if (m_Congested && m_QueuedBytes <= m_Limits.m_LowWatermark) {
+			m_Congested = false;
+			m_GraceTimer.cancel();
+			NotifyBackpressure();
+		}
 	}
 
-	void WritePacketBody() { 
-		asio::async_write(m_Socket, asio::buffer(m_OutgoingPackets.Front().m_Body.data(), m_OutgoingPackets.Front().m_Body.size()), [this](std::error_code ec, size_t length) {
-			if (!ec) {
-				m_OutgoingPackets.PopFront(); //Done writing it, take it off the list
+	void NotifyBackpressure() { //The server finds out through its incoming queue like any other event
+		if (m_Owner == Owner::Server) {
+			AddIncomingMessage(EncodeMessage(BackpressureMsg{ m_Congested, static_cast<uint32_t>(std::min<size_t>(m_QueuedBytes, UINT32_MAX)) }));
+		}
+	}
 
-				//If it's not done writing all the headers keep writing
-				if (!m_OutgoingPackets.isEmpty()) {
-					WritePacketHeader();
+	//Gather every pending packet (up to the batch limits) into one buffer sequence so a burst goes out in a single write
+	void WritePackets() {
+		m_WriteBuffers.clear();
+		m_WriteBatchCount = 0;
+		size_t frameCount = 0;
+		size_t batchBytes = 0;
+		size_t pending = m_OutgoingPackets.count();
+		size_t trailerLength = (m_Features & FEATURE_CRC32C) ? CRC_TRAILER_SIZE : 0;
+
+		//Small packets waiting at the front go out together in one Batch frame ahead of the rest
+		if ((m_Features & FEATURE_BATCHING) && pending > 1 && CanBatch(*m_OutgoingPackets.At(0)) && CanBatch(*m_OutgoingPackets.At(1))) {
+			m_BatchBody.clear();
+
+			while (m_WriteBatchCount < pending) {
+				const Packet& packet = *m_OutgoingPackets.At(m_WriteBatchCount);
+				if (!CanBatch(packet) || m_WriteBatchCount == MAX_BATCH_ENTRIES || m_BatchBody.size() + MAX_HEADER_SIZE + packet.m_Body.size() > MAX_BATCH_SIZE) {
+					break;
 				}
+
+				AppendToBatch(m_BatchBody, packet);
+				m_WriteBatchCount++;
 			}
-			else {
-				std::cout << "ID: " << m_ID << " Failed To Write Packet Body. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+
+			PacketHeader batchHeader;
+			batchHeader.m_ID = PacketType::Batch;
+			batchHeader.m_Size = static_cast<uint32_t>(m_BatchBody.size());
+
+			size_t headerLength = EncodeHeader(m_HeaderFormat, batchHeader, m_WriteHeaders[frameCount].data());
+			GatherFrame(frameCount++, headerLength, m_BatchBody);
+			batchBytes += headerLength + m_BatchBody.size() + trailerLength;
+		}
+
+		while (m_WriteBatchCount < pending && frameCount < m_WriteHeaders.size() && m_WriteBuffers.size() + 3 <= MAX_WRITE_BATCH_BUFFERS) {
+			const Packet& packet = *m_OutgoingPackets.At(m_WriteBatchCount);
+			const PacketBody& body = WireBody(packet);
+			PacketHeader wireHeader = packet.m_Header;
+			wireHeader.m_Size = static_cast<uint32_t>(body.size());
+			wireHeader.m_Flags = (&body != &packet.m_Body) ? HEADER_FLAG_COMPRESSED : 0;
+
+			size_t headerLength = EncodeHeader(m_HeaderFormat, wireHeader, m_WriteHeaders[frameCount].data());
+			size_t packetBytes = headerLength + body.size() + trailerLength;
+
+			//Always take the first frame, even if it's larger than the byte limit on its own
+			if (frameCount > 0 && batchBytes + packetBytes > MAX_WRITE_BATCH_BYTES) {
+				break;
 			}
-		});
-	}
 
-	void WritePacketBodyStr() {
-		asio::async_write(m_Socket, asio::buffer(m_OutgoingPackets.Front().m_StrBody.data(), m_OutgoingPackets.Front().m_StrBody.size()), [this](std::error_code ec, size_t length) {
+			GatherFrame(frameCount++, headerLength, body);
+			batchBytes += packetBytes;
+			m_WriteBatchCount++;
+		}
+
+		asio::async_write(m_Socket, m_WriteBuffers, [this, self = KeepAlive()](std::error_code ec, size_t) {
 			if (!ec) {
-				m_OutgoingPackets.PopFront();
+				//Done writing the whole batch, take it off the list
+				for (size_t i = 0; i < m_WriteBatchCount; i++) {
+					m_QueuedBytes -= m_OutgoingPackets.PopFront()->m_Body.size();
+					m_QueuedPackets--;
+				}
+
+				CheckWatermarks();
 
+				//Anything that was queued while the batch was being written goes out in the next one
 				if (!m_OutgoingPackets.isEmpty()) {
-					WritePacketHeader();
+					WritePackets();
 				}
 			}
 			else {
-				std::cout << "ID: " << m_ID << " Failed To Write Packet Body. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				std::cout << "ID: " << m_ID << " Failed To Write The Packets. Reason Provided: " << ec.message() << std::endl;
+				CloseSocket();
 			}
 		});
 	}
 
+	//Adds a frame whose header is already encoded to the write, followed by its checksum if the connection uses them
+	void GatherFrame(size_t frame, size_t headerLength, const PacketBody& body) {
+		const uint8_t* header = m_WriteHeaders[frame].data();
+		m_WriteBuffers.push_back(asio::buffer(header, headerLength));
+		if (body.size() > 0) {
+			m_WriteBuffers.push_back(asio::buffer(body.data(), body.size()));
+		}
+
+		if (m_Features & FEATURE_CRC32C) {
+			uint32_t crc = Crc32c(body.data(), body.size(), Crc32c(header, headerLength));
+			StoreLE(m_WriteTrailers[frame].data(), crc, CRC_TRAILER_SIZE);
+			m_WriteBuffers.push_back(asio::buffer(m_WriteTrailers[frame]));
+		}
+	}
+
+	//The body that goes on the wire, the compressed copy if there is one and this connection agreed on compression
+	const PacketBody& WireBody(const Packet& packet) const {
+		if (packet.m_CompressedBody && (m_Features & FEATURE_COMPRESSION)) {
+			return *packet.m_CompressedBody;
+		}
+
+		return packet.m_Body;
+	}
+
 	void ReadValidation() {
-		asio::async_read(m_Socket, asio::buffer(&m_HandshakeIn, sizeof(uint64_t)), [this](std::error_code ec, size_t length) {
+		asio::async_read(m_Socket, asio::buffer(&m_HandshakeIn, sizeof(uint64_t)), [this, self = KeepAlive()](std::error_code ec, size_t) {
 			if (!ec) {
 				if (m_Owner == Owner::Client) {
 					//Now rearrange those numbers to check they reach the same result
 					m_HandshakeOut = Rearrange(m_HandshakeIn);
+
+					//Server understands hellos, flip the answer so it knows one is coming
+					if (m_HandshakeIn & HANDSHAKE_HELLO) {
+						m_HandshakeOut ^= HANDSHAKE_HELLO;
+						m_SendHello = true;
+					}
+
 					WriteValidation(); //Now write it to transfer it over to the server to check
 				}
 				else { //Server is now reading the answer from client
-					if (m_HandshakeCheck == m_HandshakeIn) {
-						Packet validationPacket(PacketType::Validated, 1);
-						m_IncomingPackets.PushBack({this->shared_from_this(), validationPacket});
+					if (m_HandshakeCheck == m_HandshakeIn) { //Legacy client, stays on the original protocol
+						ApplyProtocol(ProtocolHello{}); //Version 1 headers and bodies, no features
+						AddIncomingMessage(EncodeMessage(ValidatedMsg{ 1 }));
 						ReadAccountInfo();
 					}
+					else if ((m_HandshakeCheck ^ HANDSHAKE_HELLO) == m_HandshakeIn) {
+						ReadHello();
+					}
 					else {
-						m_Account.m_AccUser = "$invalid";
 						m_ID = 0;
-						Packet validationPacket(PacketType::Validated, 0);
-						m_IncomingPackets.PushBack({ this->shared_from_this(), validationPacket });
-						m_Socket.close();
+						AddIncomingMessage(EncodeMessage(ValidatedMsg{ 0 }));
+						CloseSocket();
 					}
 				}
 			}
 			else {
 				std::cout << "ID: " << m_ID << " Failed To Read Validation. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				CloseSocket();
 			}
 		});
 	}
 
 	void WriteValidation() { 
-		asio::async_write(m_Socket, asio::buffer(&m_HandshakeOut, sizeof(uint64_t)), [this](std::error_code ec, size_t length) {
+		std::array<asio::const_buffer, 2> validation = { asio::buffer(&m_HandshakeOut, sizeof(uint64_t)), asio::const_buffer() };
+
+		if (m_SendHello) { //Client's hello goes out in the same write as its answer
+			EncodeHello({ PROTOCOL_VERSION, SUPPORTED_FEATURES }, m_HelloBuffer.data());
+			validation[1] = asio::buffer(m_HelloBuffer);
+		}
+
+		asio::async_write(m_Socket, validation, [this, self = KeepAlive()](std::error_code ec, size_t) {
 			if (!ec) {
 				//The server has the give out the inital value not the actual check value out, that has to go through the method to verify
 				//The Client will reach the if statement if it's validated due to the fact that otherwise, the server would close the connection
 				if (m_Owner == Owner::Client) {
-					WriteAccountInfo();
+					if (m_SendHello) {
+						ReadHello(); //Wait for the server to say what to use before sending anything else
+					}
+					else {
+						WriteAccountInfo();
+					}
 				}
 			}
 			else {
 				std::cout << "ID: " << m_ID << " Failed To Write Validation. Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				CloseSocket();
 			}
 		});
 	}
 
-	//I know it looks weird for both to use m_Account but remember the server will be reciving, the client sending. Connection is seperate
+	//Server reads the client's hello and answers with what was agreed on, the client reads that answer
+	void ReadHello() {
+		asio::async_read(m_Socket, asio::buffer(m_HelloBuffer), [this, self = KeepAlive()](std::error_code ec, size_t) {
+			if (!ec) {
+				ProtocolHello remote = DecodeHello(m_HelloBuffer.data());
+
+				if (m_Owner == Owner::Server) {
+					ApplyProtocol(AgreeOnProtocol({ PROTOCOL_VERSION, SUPPORTED_FEATURES }, remote));
+					WriteHello();
+					AddIncomingMessage(EncodeMessage(ValidatedMsg{ 1 }));
+					ReadAccountInfo();
+				}
+				else {
+					//Only take what was offered, in case the server answers with something we never asked for
+					ApplyProtocol(AgreeOnProtocol({ PROTOCOL_VERSION, SUPPORTED_FEATURES }, remote));
+					WriteAccountInfo();
+				}
+			}
+			else {
+				std::cout << "ID: " << m_ID << " Failed To Read Hello. Reason Provided: " << ec.message() << std::endl;
+				CloseSocket();
+			}
+		});
+	}
+
+	void WriteHello() {
+		EncodeHello({ m_ProtocolVersion, m_Features }, m_HelloBuffer.data());
+
+		asio::async_write(m_Socket, asio::buffer(m_HelloBuffer), [this, self = KeepAlive()](std::error_code ec, size_t) {
+			if (ec) {
+				std::cout << "ID: " << m_ID << " Failed To Write Hello. Reason Provided: " << ec.message() << std::endl;
+				CloseSocket();
+			}
+		});
+	}
+
+	//Bodies use the typed messages from version 2 on, version 1 peers get the original raw string layout (LegacyCodec.h).
+	//Only changes on the context, while validating
+	inline bool isLegacy() const {
+		return m_ProtocolVersion == LEGACY_PROTOCOL_VERSION;
+	}
+
+	inline LegacyDirection IncomingDirection() const {
+		return (m_Owner == Owner::Server) ? LegacyDirection::ClientToServer : LegacyDirection::ServerToClient;
+	}
+
+	inline LegacyDirection OutgoingDirection() const {
+		return (m_Owner == Owner::Server) ? LegacyDirection::ServerToClient : LegacyDirection::ClientToServer;
+	}
+
+	//Pick the fastest codecs the agreed features allow
+	void ApplyProtocol(const ProtocolHello& agreed) {
+		m_ProtocolVersion = agreed.m_Version;
+		m_Features = agreed.m_Features;
+		m_HeaderFormat = (m_Features & FEATURE_COMPACT_HEADER) ? HeaderFormat::Compact : HeaderFormat::Legacy;
+	}
+
+	//The client sends m_Account, the server reads into m_PendingAccount so it never writes the account other threads read
 	void ReadAccountInfo() {
-		asio::async_read(m_Socket, asio::buffer(&m_Account, sizeof(Account)), [this](std::error_code ec, size_t length) {
+		asio::async_read(m_Socket, asio::buffer(&m_PendingAccount, sizeof(Account)), [this, self = KeepAlive()](std::error_code ec, size_t) {
 			if (!ec) {
-				Packet usernamePacket(PacketType::AccountInfo);
-				m_IncomingPackets.PushBack({ this->shared_from_this(), usernamePacket });
+				AddIncomingMessage(EncodeMessage(AccountInfoMsg{}));
 			}
 			else {
 				std::cout << "Failure To Read Username! Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				CloseSocket();
 			}
 		});
 	}
 
 	void WriteAccountInfo() {
-		asio::async_write(m_Socket, asio::buffer(&m_Account, sizeof(Account)), [this](std::error_code ec, size_t length) {
+		asio::async_write(m_Socket, asio::buffer(&m_Account, sizeof(Account)), [this, self = KeepAlive()](std::error_code ec, size_t) {
 			if (!ec) {
-				if (m_InitalWriteAcc) { //Only want ReadPacketHeader() called once. If it's called multiple times it won't work
+				if (m_InitalWriteAcc) { //Only want ReadPackets() called once. If it's called multiple times it won't work
 					m_InitalWriteAcc = false;
-					ReadPacketHeader();
+					ReadPackets();
 				}
 			}
 			else {
 				std::cout << "Failure To Write Username! Reason Provided: " << ec.message() << std::endl;
-				m_Socket.close();
+				CloseSocket();
 			}
 		});
 	}
@@ -342,19 +844,50 @@ private:
 
 	asio::ip::tcp::socket m_Socket;
 	asio::io_context& m_AsioContext; //Reference to the owner's context
-
-	Packet m_TempPacket; //Packet used to process information when reading outgoing packets
-	TSQueue<Packet> m_OutgoingPackets;
-	TSQueue<OwnedPacket>& m_IncomingPackets; //This varible is what is responsible for transmitting the packets
+	asio::steady_timer m_GraceTimer{ m_Socket.get_executor() }; //Shares the socket's strand like every other handler
+	std::atomic<bool> m_Connected{ false };
+
+	std::vector<uint8_t> m_ReadBuffer = std::vector<uint8_t>(MIN_READ_SIZE * 4); //Bytes read from the socket but not parsed yet live in [m_ReadStart, m_ReadEnd)
+	size_t m_ReadStart = 0;
+	size_t m_ReadEnd = 0;
+	ConnectionLimits m_Limits;
+	std::atomic<size_t> m_InFlight{ 0 }; //Packets handed to the server that it hasn't handled yet
+	std::atomic<bool> m_ReadPaused{ false };
+	std::atomic<size_t> m_InboundNeeded{ 1 }; //Room the last parse stopped for, more than one when a batch didn't fit
+	MPSCQueue<SharedPacket> m_SendHandoff; //Sent from any thread, waiting for the context to take them
+	std::atomic<bool> m_DrainPosted{ false };
+	RingQueue<SharedPacket> m_OutgoingPackets; //Only touched on the context, no locking needed
+	std::vector<asio::const_buffer> m_WriteBuffers; //Reused buffer sequence for the batch currently being written
+	std::array<std::array<uint8_t, MAX_HEADER_SIZE>, MAX_WRITE_BATCH_BUFFERS / 2> m_WriteHeaders; //Encoded headers of the batch
+	std::array<std::array<uint8_t, CRC_TRAILER_SIZE>, MAX_WRITE_BATCH_BUFFERS / 2> m_WriteTrailers; //Checksums of the batch, one per header
+	size_t m_WriteBatchCount = 0; //How many packets at the front of m_OutgoingPackets the current write covers
+	PacketBody m_BatchBody; //Body of the Batch frame in the current write, reused between writes
+	std::atomic<size_t> m_QueuedPackets{ 0 };
+	std::atomic<size_t> m_QueuedBytes{ 0 }; //Body bytes in m_OutgoingPackets, checked against the watermarks
+	std::atomic<bool> m_Congested{ false };
+	IncomingPacketQueue& m_IncomingPackets; //This varible is what is responsible for transmitting the packets
+	std::function<void(OwnedPacket&&)> m_PacketHandler; //Takes the place of m_IncomingPackets when set
 
 	uint64_t m_HandshakeOut = 0;
 	uint64_t m_HandshakeIn = 0;
 	uint64_t m_HandshakeCheck = 0;
+	std::array<uint8_t, HELLO_SIZE> m_HelloBuffer;
+	bool m_SendHello = false; //Client side, the server asked for a hello
+	//Set on the strand during the handshake, read by the dispatch threads
+	std::atomic<uint16_t> m_ProtocolVersion{ LEGACY_PROTOCOL_VERSION };
+	std::atomic<uint32_t> m_Features{ 0 }; //Features both sides agreed on
+	HeaderFormat m_HeaderFormat = HeaderFormat::Legacy; //Picked from the agreed features, used for both directions
 
 	Owner m_Owner;
-	uint32_t m_ID = 0;
-	unsigned int m_PermIndex;
+	std::atomic<uint32_t> m_ID{ 0 }; //Logged from the strand and the dispatch threads, zeroed by IgnoreConnection
+	SlabHandle m_Handle = INVALID_SLAB_HANDLE;
+	std::atomic<UserID> m_UserID{ UserID::None };
+	//Client side it belongs to whoever calls ConnectToServer / SetAccount. Server side it's only touched with the
+	//server's state lock held, the strand reads the client's account into m_PendingAccount instead
 	Account m_Account;
+	Account m_PendingAccount;
+	std::weak_ptr<Connection> m_Partner; //Weak so two chatting connections don't keep each other alive
+	std::string m_ChatName; //Own username as of when the conversation with m_Partner started
 	bool m_InitalWriteAcc = true;
-	bool m_ServerApproved = false; //For the server side when making the online list so invalid account information connections don't print
+	std::atomic<bool> m_ServerApproved{ false }; //For the server side when making the online list so invalid account information connections don't print
 };
\ No newline at end of file
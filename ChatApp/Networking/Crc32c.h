@@ -0,0 +1,112 @@
+#pragma once
+#include "NetIncludes.h"
+#include <atomic>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#endif
+
+//CRC32C (Castagnoli) of the frames on connections that agreed on FEATURE_CRC32C. Uses the SSE4.2 crc32 instruction
+//when the cpu has it (checked once at runtime) or the ARMv8 one when built for it, a lookup table otherwise.
+//Pass the previous result as crc to continue a checksum over another piece of data
+constexpr size_t CRC_TRAILER_SIZE = 4; //Little endian, after the body
+
+constexpr std::array<uint32_t, 256> MakeCrc32cTable() {
+	std::array<uint32_t, 256> table{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+		}
+
+		table[i] = crc;
+	}
+
+	return table;
+}
+
+inline uint32_t Crc32cTable(uint32_t crc, const uint8_t* data, size_t size) {
+	static constexpr std::array<uint32_t, 256> table = MakeCrc32cTable();
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+#if defined(CRC32C_X86)
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+inline uint32_t Crc32cHardware(uint32_t crc, const uint8_t* data, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+	uint64_t crc64 = crc;
+	for (; size >= 8; size -= 8, data += 8) {
+		uint64_t chunk;
+		std::memcpy(&chunk, data, 8);
+		crc64 = _mm_crc32_u64(crc64, chunk);
+	}
+	crc = static_cast<uint32_t>(crc64);
+#endif
+	for (; size > 0; size--, data++) {
+		crc = _mm_crc32_u8(crc, *data);
+	}
+
+	return crc;
+}
+
+inline bool HasHardwareCrc32c() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0; //ECX bit 20 is SSE4.2
+#else
+	return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(CRC32C_ARM)
+inline uint32_t Crc32cHardware(uint32_t crc, const uint8_t* data, size_t size) {
+	for (; size >= 8; size -= 8, data += 8) {
+		uint64_t chunk;
+		std::memcpy(&chunk, data, 8);
+		crc = __crc32cd(crc, chunk);
+	}
+
+	for (; size > 0; size--, data++) {
+		crc = __crc32cb(crc, *data);
+	}
+
+	return crc;
+}
+
+inline bool HasHardwareCrc32c() {
+	return true;
+}
+#endif
+
+inline uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc = 0) {
+	crc = ~crc;
+
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+	static const bool hardware = HasHardwareCrc32c();
+	crc = hardware ? Crc32cHardware(crc, data, size) : Crc32cTable(crc, data, size);
+#else
+	crc = Crc32cTable(crc, data, size);
+#endif
+
+	return ~crc;
+}
+
+//Frames that failed their checksum since the process started, each one closed its connection
+inline std::atomic<uint64_t>& ChecksumFailures() {
+	static std::atomic<uint64_t> failures{ 0 };
+	return failures;
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+#include "Messages.h"
+#include <initializer_list>
+
+//Version 1 peers don't know about the typed messages. They put a raw string in the body, with several fields joined
+//by ':' (or '#' for a password change), and memcpy'd numbers in the few types that carry one. Connections at
+//LEGACY_PROTOCOL_VERSION translate to and from that layout at the socket, everything past it only sees typed messages.
+//Usernames are letters and numbers only, so splitting on the separators is safe
+
+//The original layout of Message and LeaveConvo depends on who is sending them
+enum class LegacyDirection {
+	ClientToServer, ServerToClient
+};
+
+inline Packet LegacyStringPacket(PacketType type, std::initializer_list<std::string_view> pieces) {
+	Packet packet(type);
+	for (std::string_view piece : pieces) {
+		packet.m_Body.append(reinterpret_cast<const uint8_t*>(piece.data()), piece.size());
+	}
+
+	packet.m_Header.m_Size = static_cast<uint32_t>(packet.m_Body.size());
+	return packet;
+}
+
+inline std::string_view LegacyString(const Packet& packet) {
+	return std::string_view(reinterpret_cast<const char*>(packet.m_Body.data()), packet.m_Body.size());
+}
+
+//Typed packet to the bytes a version 1 peer expects. False if version 1 never had the type or the body is malformed
+inline bool EncodeLegacy(const Packet& packet, LegacyDirection direction, Packet& legacy) {
+	PacketType type = packet.m_Header.m_ID;
+
+	switch (type) {
+		case PacketType::ServerAccept:
+		case PacketType::ServerReject: //A single int32, the same bytes the memcpy left on little endian machines
+		case PacketType::LeaveServer:
+		case PacketType::ClientExit:
+		case PacketType::ServerExit:
+			legacy = packet;
+			return true;
+
+		case PacketType::OnlineList: {
+			OnlineListMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_List });
+			return true;
+		}
+
+		case PacketType::ServerMessage: {
+			ServerMessageMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_Text });
+			return true;
+		}
+
+		case PacketType::MessageAll: {
+			MessageAllMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_Text });
+			return true;
+		}
+
+		case PacketType::Message: { //"sender:text" going to the server, only the text coming back
+			ChatMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			if (direction == LegacyDirection::ClientToServer) {
+				legacy = LegacyStringPacket(type, { message.m_Sender, ":", message.m_Text });
+			}
+			else {
+				legacy = LegacyStringPacket(type, { message.m_Text });
+			}
+
+			return true;
+		}
+
+		case PacketType::ChatRequest: {
+			ChatRequestMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_Receiver });
+			return true;
+		}
+
+		case PacketType::ChatAlert: {
+			ChatAlertMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_Requester });
+			return true;
+		}
+
+		case PacketType::ChatAlertResponse: { //"receiver:initiator:t" or ":f"
+			ChatAlertResponseMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_Receiver, ":", message.m_Initiator, ":", message.m_Accepted ? "t" : "f" });
+			return true;
+		}
+
+		case PacketType::ChatResponse: { //"receiver:code", old clients only read the first digit of the code
+			ChatResponseMsg message;
+			if (!DecodeMessage(packet, message) || message.m_Code > 9) {
+				return false;
+			}
+
+			char code = static_cast<char>('0' + message.m_Code);
+			legacy = LegacyStringPacket(type, { message.m_Receiver, ":", std::string_view(&code, 1) });
+			return true;
+		}
+
+		case PacketType::ChangePassword: { //"user#password"
+			ChangePasswordMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { message.m_User, "#", message.m_NewPassword });
+			return true;
+		}
+
+		case PacketType::LeaveConvo: { //Who is leaving going to the server, nothing coming back
+			LeaveConvoMsg message;
+			if (!DecodeMessage(packet, message)) {
+				return false;
+			}
+
+			legacy = LegacyStringPacket(type, { (direction == LegacyDirection::ClientToServer) ? message.m_User : std::string_view() });
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+//Bytes from a version 1 peer to the typed packet. False if version 1 never sent the type or the body is malformed
+inline bool DecodeLegacy(const Packet& legacy, LegacyDirection direction, Packet& packet) {
+	PacketType type = legacy.m_Header.m_ID;
+	std::string_view body = LegacyString(legacy);
+
+	switch (type) {
+		case PacketType::ServerAccept:
+		case PacketType::ServerReject:
+		case PacketType::LeaveServer:
+		case PacketType::ClientExit:
+		case PacketType::ServerExit:
+			packet = legacy;
+			return true;
+
+		case PacketType::OnlineList:
+			packet = EncodeMessage(OnlineListMsg{ body });
+			return true;
+
+		case PacketType::ServerMessage:
+			packet = EncodeMessage(ServerMessageMsg{ body });
+			return true;
+
+		case PacketType::MessageAll:
+			packet = EncodeMessage(MessageAllMsg{ body });
+			return true;
+
+		case PacketType::Message: {
+			if (direction == LegacyDirection::ServerToClient) { //The client knows who it's talking to
+				packet = EncodeMessage(ChatMsg{ std::string_view(), body });
+				return true;
+			}
+
+			size_t split = body.find(':');
+			if (split == std::string_view::npos) {
+				return false;
+			}
+
+			packet = EncodeMessage(ChatMsg{ body.substr(0, split), body.substr(split + 1) });
+			return true;
+		}
+
+		case PacketType::ChatRequest:
+			packet = EncodeMessage(ChatRequestMsg{ body });
+			return true;
+
+		case PacketType::ChatAlert:
+			packet = EncodeMessage(ChatAlertMsg{ body });
+			return true;
+
+		case PacketType::ChatAlertResponse: {
+			size_t first = body.find(':'), last = body.rfind(':');
+			if (first == std::string_view::npos || first == last) {
+				return false;
+			}
+
+			ChatAlertResponseMsg message;
+			message.m_Receiver = body.substr(0, first);
+			message.m_Initiator = body.substr(first + 1, last - first - 1);
+			message.m_Accepted = body.substr(last + 1) == "t";
+			packet = EncodeMessage(message);
+			return true;
+		}
+
+		case PacketType::ChatResponse: {
+			size_t split = body.rfind(':');
+			if (split == std::string_view::npos || split + 1 >= body.size() || body[split + 1] < '0' || body[split + 1] > '9') {
+				return false;
+			}
+
+			packet = EncodeMessage(ChatResponseMsg{ body.substr(0, split), static_cast<uint8_t>(body[split + 1] - '0') });
+			return true;
+		}
+
+		case PacketType::ChangePassword: {
+			size_t split = body.find('#');
+			if (split == std::string_view::npos) {
+				return false;
+			}
+
+			packet = EncodeMessage(ChangePasswordMsg{ body.substr(0, split), body.substr(split + 1) });
+			return true;
+		}
+
+		case PacketType::LeaveConvo: //Old clients also send it with no name when leaving the server
+			packet = EncodeMessage(LeaveConvoMsg{ body });
+			return true;
+
+		default:
+			return false;
+	}
+}
\ No newline at end of file
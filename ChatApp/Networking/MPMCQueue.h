@@ -0,0 +1,171 @@
+#pragma once
+#include "NetIncludes.h"
+#include <atomic>
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+//Bounded lock free queue for many producers and many consumers (Vyukov's ring). Every slot carries a sequence
+//number saying whose turn it is, so a push or pop is one compare and swap on its position plus one store, with no
+//lock at all. The positions and slots are each on their own cache line so producers and consumers don't keep
+//stealing the same line from each other. Covers the consuming calls TSQueue has (TryPopFront, PopAll, Wait) so
+//either can back IncomingPacketQueue. A push into a full queue waits for a consumer to make room
+template<typename T>
+class MPMCQueue {
+public:
+	MPMCQueue(size_t capacity = 4096) {
+		size_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		m_Mask = size - 1;
+		m_Cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++) {
+			m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MPMCQueue(const MPMCQueue&) = delete;
+
+	void PushBack(const T& data) {
+		PushBack(T(data));
+	}
+
+	void PushBack(T&& data) {
+		while (!TryPushBack(std::move(data))) {
+			std::this_thread::yield();
+		}
+	}
+
+	//Returns false without touching data if the queue is full
+	bool TryPushBack(T&& data) {
+		Cell* cell;
+		size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+
+		while (true) {
+			cell = &m_Cells[pos & m_Mask];
+			size_t sequence = cell->m_Sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+			if (difference == 0) { //Slot is free, claim it
+				if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) { //Slot still holds an item from the last lap, full
+				return false;
+			}
+			else { //Another producer claimed it first
+				pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->m_Data = std::move(data);
+		cell->m_Sequence.store(pos + 1, std::memory_order_release);
+		WakeWaiters();
+		return true;
+	}
+
+	bool TryPopFront(T& out) {
+		Cell* cell;
+		size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+
+		while (true) {
+			cell = &m_Cells[pos & m_Mask];
+			size_t sequence = cell->m_Sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+			if (difference == 0) {
+				if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if (difference < 0) { //Nothing written to it yet, empty
+				return false;
+			}
+			else {
+				pos = m_DequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		out = std::move(cell->m_Data);
+		cell->m_Data = T(); //Let go of anything the moved from item still holds
+		cell->m_Sequence.store(pos + m_Mask + 1, std::memory_order_release); //Free for the producers' next lap
+		return true;
+	}
+
+	//Only call when the queue is known not to be empty, waits out a push that claimed a slot but hasn't filled it
+	T PopFront() {
+		T item;
+		while (!TryPopFront(item)) {
+			std::this_thread::yield();
+		}
+
+		return item;
+	}
+
+	void PopAll(std::deque<T>& out) {
+		T item;
+		while (TryPopFront(item)) {
+			out.push_back(std::move(item));
+		}
+	}
+
+	void Wait() {
+		std::unique_lock<std::mutex> lock(m_WaitMutex);
+		m_Waiters++;
+		std::atomic_thread_fence(std::memory_order_seq_cst); //Pairs with the fence in WakeWaiters()
+		m_WaitCV.wait(lock, [this]() { return !isEmpty(); });
+		m_Waiters--;
+	}
+
+	template<typename Rep, typename Period>
+	bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> lock(m_WaitMutex);
+		m_Waiters++;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool ready = m_WaitCV.wait_for(lock, timeout, [this]() { return !isEmpty(); });
+		m_Waiters--;
+		return ready;
+	}
+
+	void Clear() {
+		T item;
+		while (TryPopFront(item)) { }
+	}
+
+	//Only a snapshot, other threads can change it straight after
+	bool isEmpty() const {
+		return count() == 0;
+	}
+
+	size_t count() const {
+		size_t dequeued = m_DequeuePos.load(std::memory_order_acquire);
+		size_t enqueued = m_EnqueuePos.load(std::memory_order_acquire);
+		return (enqueued > dequeued) ? enqueued - dequeued : 0;
+	}
+
+private:
+	//Consumers only sleep through Wait(), so pushes skip the mutex entirely unless someone is actually waiting
+	void WakeWaiters() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_Waiters.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(m_WaitMutex);
+			m_WaitCV.notify_all();
+		}
+	}
+
+	struct alignas(CACHE_LINE_SIZE) Cell {
+		std::atomic<size_t> m_Sequence;
+		T m_Data;
+	};
+
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_EnqueuePos{ 0 };
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_DequeuePos{ 0 };
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_Waiters{ 0 };
+	std::unique_ptr<Cell[]> m_Cells;
+	size_t m_Mask;
+
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCV;
+};
\ No newline at end of file
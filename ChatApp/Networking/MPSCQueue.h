@@ -0,0 +1,58 @@
+#pragma once
+#include "NetIncludes.h"
+#include <atomic>
+
+//Lock free queue any number of threads can push into and a single thread pops from (Vyukov's node based queue).
+//A push is one allocation and one atomic exchange. Items from the same producer come out in the order they went in
+template<typename T>
+class MPSCQueue {
+public:
+	MPSCQueue() {
+		Node* stub = new Node();
+		m_Head = stub;
+		m_Tail = stub;
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+
+	~MPSCQueue() {
+		T item;
+		while (Pop(item)) { }
+
+		delete m_Tail;
+	}
+
+	void Push(T&& data) { //Any thread
+		Node* node = new Node();
+		node->m_Item = std::move(data);
+
+		Node* previous = m_Head.exchange(node);
+		previous->m_Next.store(node);
+	}
+
+	//Consumer thread only. Can miss an item whose push is still half way through, the caller has to make sure
+	//someone checks again once that push completes
+	bool Pop(T& item) {
+		Node* tail = m_Tail;
+		Node* next = tail->m_Next.load();
+		if (!next) {
+			return false;
+		}
+
+		//The popped node becomes the new stub, the old stub goes
+		item = std::move(next->m_Item);
+		next->m_Item = T();
+		m_Tail = next;
+		delete tail;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node*> m_Next{ nullptr };
+		T m_Item;
+	};
+
+	std::atomic<Node*> m_Head; //Producers push here
+	Node* m_Tail; //Consumer pops from here
+};
\ No newline at end of file
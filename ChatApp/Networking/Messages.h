@@ -0,0 +1,338 @@
+#pragma once
+#include "Packet.h"
+#include "WireFormat.h"
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+//Every packet type has a message struct listing its fields in wire order. EncodeMessage / DecodeMessage walk that
+//list at compile time, so there is no hand written parsing. Decoded strings are views into the packet's body,
+//they are only valid for as long as the packet is.
+//Field encoding: string_view is a varint length followed by the bytes, bool and uint8_t take one byte,
+//int32_t / uint32_t take four bytes little endian, UserID is a varint and a std::vector of records is a varint count
+//followed by each record's fields
+
+//Lists the fields of a message, in the order they are written
+#define MESSAGE_FIELDS(...) \
+	auto Fields() { return std::tie(__VA_ARGS__); } \
+	auto Fields() const { return std::tie(__VA_ARGS__); }
+
+//Number the server gives a user when they log in, only usernames go over the wire otherwise. Handed out in order
+//and never reused while the server runs, so even thousands of users take two or three bytes
+enum class UserID : uint32_t {
+	None = 0
+};
+
+struct ServerAcceptMsg {
+	static constexpr PacketType Type = PacketType::ServerAccept;
+	MESSAGE_FIELDS()
+};
+
+struct ServerRejectMsg {
+	static constexpr PacketType Type = PacketType::ServerReject;
+	int32_t m_Reason = 0;
+	MESSAGE_FIELDS(m_Reason)
+};
+
+struct OnlineListMsg {
+	static constexpr PacketType Type = PacketType::OnlineList;
+	std::string_view m_List;
+	MESSAGE_FIELDS(m_List)
+};
+
+struct ChatMsg { //A conversation message, PacketType::Message
+	static constexpr PacketType Type = PacketType::Message;
+	std::string_view m_Sender;
+	std::string_view m_Text;
+	MESSAGE_FIELDS(m_Sender, m_Text)
+};
+
+//Connections with FEATURE_USER_IDS send this instead of ChatMsg. m_User is the other end of the conversation: who
+//it's for when the client sends it, who it's from when the server forwards it
+struct UserChatMsg {
+	static constexpr PacketType Type = PacketType::UserMessage;
+	UserID m_User = UserID::None;
+	std::string_view m_Text;
+	MESSAGE_FIELDS(m_User, m_Text)
+};
+
+struct UserInfoMsg { //Sent ahead of anything that introduces a user to a client that addresses users by ID
+	static constexpr PacketType Type = PacketType::UserInfo;
+	UserID m_ID = UserID::None;
+	std::string_view m_User;
+	MESSAGE_FIELDS(m_ID, m_User)
+};
+
+enum class PresenceChange : uint8_t {
+	Join, Leave, Status
+};
+
+struct PresenceRecord { //One user as clients with FEATURE_PRESENCE see them
+	UserID m_ID = UserID::None;
+	uint8_t m_Status = 0; //A ChatStatus
+	std::string_view m_User;
+	MESSAGE_FIELDS(m_ID, m_Status, m_User)
+};
+
+//The server's presence version goes up by one with every delta. A snapshot is the whole table at a version, from
+//there the client applies each delta in turn and asks for a new snapshot if one is ever skipped
+struct PresenceSnapshotMsg {
+	static constexpr PacketType Type = PacketType::PresenceSnapshot;
+	uint32_t m_Version = 0;
+	std::vector<PresenceRecord> m_Users;
+	MESSAGE_FIELDS(m_Version, m_Users)
+};
+
+struct PresenceDeltaMsg {
+	static constexpr PacketType Type = PacketType::PresenceDelta;
+	uint32_t m_Version = 0;
+	uint8_t m_Change = 0; //A PresenceChange
+	PresenceRecord m_Record; //Only the ID is filled in when leaving, the username only when joining
+	MESSAGE_FIELDS(m_Version, m_Change, m_Record.m_ID, m_Record.m_Status, m_Record.m_User)
+};
+
+struct PresenceResyncMsg {
+	static constexpr PacketType Type = PacketType::PresenceResync;
+	MESSAGE_FIELDS()
+};
+
+struct ServerMessageMsg {
+	static constexpr PacketType Type = PacketType::ServerMessage;
+	std::string_view m_Text;
+	MESSAGE_FIELDS(m_Text)
+};
+
+struct MessageAllMsg {
+	static constexpr PacketType Type = PacketType::MessageAll;
+	std::string_view m_Text;
+	MESSAGE_FIELDS(m_Text)
+};
+
+struct ChatRequestMsg {
+	static constexpr PacketType Type = PacketType::ChatRequest;
+	std::string_view m_Receiver;
+	MESSAGE_FIELDS(m_Receiver)
+};
+
+struct ChatAlertMsg {
+	static constexpr PacketType Type = PacketType::ChatAlert;
+	std::string_view m_Requester;
+	MESSAGE_FIELDS(m_Requester)
+};
+
+struct ChatAlertResponseMsg {
+	static constexpr PacketType Type = PacketType::ChatAlertResponse;
+	std::string_view m_Receiver; //The user who answered the request
+	std::string_view m_Initiator; //The user who sent the request
+	bool m_Accepted = false;
+	MESSAGE_FIELDS(m_Receiver, m_Initiator, m_Accepted)
+};
+
+struct ChatResponseMsg {
+	static constexpr PacketType Type = PacketType::ChatResponse;
+	std::string_view m_Receiver;
+	uint8_t m_Code = 0; //0 is accepted, anything else is the reason it can't happen
+	MESSAGE_FIELDS(m_Receiver, m_Code)
+};
+
+struct AccountInfoMsg {
+	static constexpr PacketType Type = PacketType::AccountInfo;
+	MESSAGE_FIELDS()
+};
+
+struct ChangePasswordMsg {
+	static constexpr PacketType Type = PacketType::ChangePassword;
+	std::string_view m_User;
+	std::string_view m_NewPassword;
+	MESSAGE_FIELDS(m_User, m_NewPassword)
+};
+
+struct ValidatedMsg {
+	static constexpr PacketType Type = PacketType::Validated;
+	int32_t m_Result = 0;
+	MESSAGE_FIELDS(m_Result)
+};
+
+struct LeaveConvoMsg {
+	static constexpr PacketType Type = PacketType::LeaveConvo;
+	std::string_view m_User; //Who left the conversation
+	MESSAGE_FIELDS(m_User)
+};
+
+struct LeaveServerMsg {
+	static constexpr PacketType Type = PacketType::LeaveServer;
+	MESSAGE_FIELDS()
+};
+
+struct ClientExitMsg {
+	static constexpr PacketType Type = PacketType::ClientExit;
+	MESSAGE_FIELDS()
+};
+
+struct ServerExitMsg {
+	static constexpr PacketType Type = PacketType::ServerExit;
+	MESSAGE_FIELDS()
+};
+
+struct BackpressureMsg { //Only ever made by the connection itself, never read off the wire
+	static constexpr PacketType Type = PacketType::Backpressure;
+	bool m_Congested = false; //True when it went over the high watermark, false once it drained under the low one
+	uint32_t m_QueuedBytes = 0;
+	MESSAGE_FIELDS(m_Congested, m_QueuedBytes)
+};
+
+inline void WriteField(PacketBody& body, std::string_view field) {
+	WriteVarint(body, field.size());
+	body.append(reinterpret_cast<const uint8_t*>(field.data()), field.size());
+}
+
+inline void WriteField(PacketBody& body, bool field) {
+	WriteLE(body, field ? 1 : 0, 1);
+}
+
+inline void WriteField(PacketBody& body, uint8_t field) {
+	WriteLE(body, field, 1);
+}
+
+inline void WriteField(PacketBody& body, int32_t field) {
+	WriteLE(body, static_cast<uint32_t>(field), 4);
+}
+
+inline void WriteField(PacketBody& body, uint32_t field) {
+	WriteLE(body, field, 4);
+}
+
+inline void WriteField(PacketBody& body, UserID field) {
+	WriteVarint(body, static_cast<uint32_t>(field));
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, std::string_view& field) {
+	uint64_t length;
+	if (!ReadVarint(body.data(), body.size(), offset, length) || length > body.size() - offset) {
+		return false;
+	}
+
+	field = std::string_view(reinterpret_cast<const char*>(body.data() + offset), static_cast<size_t>(length));
+	offset += static_cast<size_t>(length);
+	return true;
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, bool& field) {
+	if (body.size() - offset < 1) {
+		return false;
+	}
+
+	field = body.data()[offset++] != 0;
+	return true;
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, uint8_t& field) {
+	if (body.size() - offset < 1) {
+		return false;
+	}
+
+	field = body.data()[offset++];
+	return true;
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, int32_t& field) {
+	if (body.size() - offset < 4) {
+		return false;
+	}
+
+	field = static_cast<int32_t>(static_cast<uint32_t>(ReadLE(body.data() + offset, 4)));
+	offset += 4;
+	return true;
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, uint32_t& field) {
+	if (body.size() - offset < 4) {
+		return false;
+	}
+
+	field = static_cast<uint32_t>(ReadLE(body.data() + offset, 4));
+	offset += 4;
+	return true;
+}
+
+inline bool ReadField(const PacketBody& body, size_t& offset, UserID& field) {
+	uint64_t value;
+	if (!ReadVarint(body.data(), body.size(), offset, value) || value > UINT32_MAX) {
+		return false;
+	}
+
+	field = static_cast<UserID>(value);
+	return true;
+}
+
+template<typename Record>
+void WriteField(PacketBody& body, const std::vector<Record>& field) {
+	WriteVarint(body, field.size());
+
+	for (const Record& record : field) {
+		std::apply([&body](const auto&... fields) { (WriteField(body, fields), ...); }, record.Fields());
+	}
+}
+
+template<typename Record>
+bool ReadField(const PacketBody& body, size_t& offset, std::vector<Record>& field) {
+	uint64_t count;
+	if (!ReadVarint(body.data(), body.size(), offset, count) || count > body.size() - offset) { //Every record takes a byte at least
+		return false;
+	}
+
+	field.resize(static_cast<size_t>(count));
+	for (Record& record : field) {
+		if (!std::apply([&body, &offset](auto&... fields) { return (ReadField(body, offset, fields) && ...); }, record.Fields())) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<typename Message>
+Packet EncodeMessage(const Message& message) {
+	Packet packet(Message::Type);
+	std::apply([&packet](const auto&... fields) { (WriteField(packet.m_Body, fields), ...); }, message.Fields());
+	packet.m_Header.m_Size = static_cast<uint32_t>(packet.m_Body.size());
+	return packet;
+}
+
+//Fails if the packet is of another type, is cut short or has bytes left over
+template<typename Message>
+bool DecodeMessage(const Packet& packet, Message& message) {
+	if (packet.m_Header.m_ID != Message::Type) {
+		return false;
+	}
+
+	size_t offset = 0;
+	bool decoded = std::apply([&packet, &offset](auto&... fields) { return (ReadField(packet.m_Body, offset, fields) && ...); }, message.Fields());
+	return decoded && offset == packet.m_Body.size();
+}
+
+//Swaps the first field of an already decoded packet for a new value, moving the rest of the body up or down in the
+//buffer it's already in. Lets the server pass a message on without encoding it again, decoded views into the packet
+//aren't valid afterwards
+template<typename Field>
+bool ReplaceFirstField(Packet& packet, const Field& field) {
+	Field old;
+	size_t oldLength = 0;
+	if (!ReadField(packet.m_Body, oldLength, old)) {
+		return false;
+	}
+
+	PacketBody encoded;
+	WriteField(encoded, field);
+
+	size_t rest = packet.m_Body.size() - oldLength, newSize = encoded.size() + rest;
+	if (newSize > packet.m_Body.size()) {
+		packet.m_Body.resize(newSize);
+	}
+
+	std::memmove(packet.m_Body.data() + encoded.size(), packet.m_Body.data() + oldLength, rest);
+	std::memcpy(packet.m_Body.data(), encoded.data(), encoded.size());
+	packet.m_Body.resize(newSize);
+	packet.m_Header.m_Size = static_cast<uint32_t>(newSize);
+	return true;
+}
\ No newline at end of file
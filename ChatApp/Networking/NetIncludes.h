@@ -1,6 +1,6 @@
 #pragma once
 
-enum class PacketType { //If the packet type uses strings it will be even, if not odd
+enum class PacketType { //Every type has a message struct describing its body in Messages.h
 	ServerAccept = 1,
 	ServerReject = 7, //Account was rejected upon inital login / sign up information
 	OnlineList = 0,
@@ -17,7 +17,14 @@ enum class PacketType { //If the packet type uses strings it will be even, if no
 	LeaveConvo = 16,
 	LeaveServer = 3, //Force said client to leave the server
 	ClientExit = 9, //Client has exited the application
-	ServerExit = 11
+	ServerExit = 11,
+	Batch = 21, //Envelope holding several packets, only used on the wire and unpacked before dispatch (see Batch.h)
+	Backpressure = 22, //Never sent, a connection telling the server its outgoing queue crossed a watermark
+	UserMessage = 23, //A conversation message addressed by user ID instead of username, see FEATURE_USER_IDS
+	UserInfo = 24, //The user ID a username goes by
+	PresenceSnapshot = 25, //Everyone online, for clients with FEATURE_PRESENCE that are new or lost track
+	PresenceDelta = 26, //One user joining, leaving or changing status since the last snapshot or delta
+	PresenceResync = 27 //A client asking for a fresh snapshot after missing a delta
 };
 
 #define ASIO_STANDALONE
@@ -31,8 +38,14 @@ enum class PacketType { //If the packet type uses strings it will be even, if no
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include <array>
 #include <deque>
+#include <condition_variable>
+#include <iterator>
+#include <functional>
 #include <fstream>
 #include <ctime>
 #include <algorithm>
-#include <stdlib.h>
\ No newline at end of file
+#include <stdlib.h>
+
+constexpr size_t PACKET_TYPE_COUNT = 28; //One past the largest PacketType value
\ No newline at end of file
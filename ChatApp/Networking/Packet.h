@@ -1,11 +1,17 @@
 #pragma once
 #include "NetIncludes.h"
+#include "PacketBuffer.h"
 
 struct PacketHeader {
 	PacketType m_ID; //What type of message it will be
-	uint32_t m_Size; //The size of the body so it can allocate enough space to read it
+	uint32_t m_Size = 0; //The size of the body so it can allocate enough space to read it
+	uint8_t m_Flags = 0; //Wire flags like HEADER_FLAG_COMPRESSED, only set while the packet is on the wire
 };
 
+//Sized from the message size histogram: nearly every body (a chat message with its sender, a username, a
+//response code) fits in 128 bytes. Only large ones like OnlineList go to the heap
+using PacketBody = PacketBuffer<uint8_t, 128>;
+
 class Packet {
 public:
 	Packet(PacketType type = PacketType::Message) {
@@ -27,8 +33,8 @@ public:
 
 	Packet(PacketType type, const std::string& str) {
 		m_Header.m_ID = type;
-		std::copy(str.begin(), str.end(), std::back_inserter(m_StrBody));
-		m_Header.m_Size = m_StrBody.size();
+		m_Body.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+		m_Header.m_Size = m_Body.size();
 	}
 
 	//For printing out the general information of the packet
@@ -96,13 +102,40 @@ public:
 				type = "Client Exit";
 				break;
 
+			case PacketType::Batch:
+				type = "Batch";
+				break;
+
+			case PacketType::Backpressure:
+				type = "Backpressure";
+				break;
+
+			case PacketType::UserMessage:
+				type = "User Message";
+				break;
+
+			case PacketType::UserInfo:
+				type = "User Info";
+				break;
+
+			case PacketType::PresenceSnapshot:
+				type = "Presence Snapshot";
+				break;
+
+			case PacketType::PresenceDelta:
+				type = "Presence Delta";
+				break;
+
+			case PacketType::PresenceResync:
+				type = "Presence Resync";
+				break;
+
 			default:
 				type = "Packet Type Unknown";
 				break;
 		}
 
-		os << "Packet Type: " << type << "\nTotal Body Size: " << packet.m_Body.size() << " bytes\n";
-		os << "Total String Body Size: " << packet.m_StrBody.size() << " bytes";
+		os << "Packet Type: " << type << "\nTotal Body Size: " << packet.m_Body.size() << " bytes";
 		return os;
 	}
 
@@ -121,8 +154,8 @@ public:
 	}
 
 	friend Packet& operator<<(Packet& packet, const std::string& str) {
-		std::copy(str.begin(), str.end(), std::back_inserter(packet.m_StrBody));
-		packet.m_Header.m_Size = packet.m_StrBody.size();
+		packet.m_Body.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+		packet.m_Header.m_Size = packet.m_Body.size();
 		return packet;
 	}
 
@@ -140,21 +173,23 @@ public:
 	}
 
 	friend Packet& operator>>(Packet& packet, std::string& str) {
-		str = std::string(packet.m_StrBody.begin(), packet.m_StrBody.end());
+		str = std::string(packet.m_Body.begin(), packet.m_Body.end());
 
-		//Will take the whole string in one take, clear the vector
-		packet.m_StrBody.clear();
-		packet.m_StrBody.resize(0);
+		//Will take the whole string in one take, clear the buffer
+		packet.m_Body.clear();
 		packet.m_Header.m_Size = packet.m_Body.size();
 
 		return packet;
 	}
 
 	PacketHeader m_Header;
-	std::vector<uint8_t> m_Body;
-	std::vector<char> m_StrBody;
+	PacketBody m_Body;
+	std::shared_ptr<const PacketBody> m_CompressedBody; //Set by SharePacket when compressing the body paid off
 };
 
+//A finished packet that is no longer changed. Broadcasts build one and every recipient's queue points to it
+using SharedPacket = std::shared_ptr<const Packet>;
+
 //Foward declartion due to circular dependency
 class Connection;
 
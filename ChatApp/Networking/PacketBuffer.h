@@ -0,0 +1,170 @@
+#pragma once
+#include "NetIncludes.h"
+#include "BufferPool.h"
+
+//Growable buffer that keeps small payloads inside the object and only goes to the heap once they outgrow it.
+//Used for the packet bodies since almost every packet sent is a short message or a single number.
+//Heap blocks come from the BufferPool and go back to it when the buffer is destroyed
+template<typename T, size_t InlineCapacity>
+class PacketBuffer {
+	static_assert(std::is_trivially_copyable<T>::value, "Buffer data must be trivially copyable");
+
+public:
+	using value_type = T;
+
+	PacketBuffer() = default;
+
+	PacketBuffer(const PacketBuffer& other) {
+		assign(other.data(), other.size());
+	}
+
+	PacketBuffer(PacketBuffer&& other) noexcept {
+		TakeFrom(other);
+	}
+
+	~PacketBuffer() {
+		Release();
+	}
+
+	PacketBuffer& operator=(const PacketBuffer& other) {
+		if (this != &other) {
+			assign(other.data(), other.size());
+		}
+
+		return *this;
+	}
+
+	PacketBuffer& operator=(PacketBuffer&& other) noexcept {
+		if (this != &other) {
+			Release();
+			TakeFrom(other);
+		}
+
+		return *this;
+	}
+
+	void reserve(size_t capacity) {
+		if (capacity <= m_Capacity) {
+			return;
+		}
+
+		size_t blockSize = 0;
+		T* heap = static_cast<T*>(BufferPool::Get().Acquire(capacity * sizeof(T), blockSize));
+		std::memcpy(heap, data(), m_Size * sizeof(T));
+		Release();
+
+		m_Heap = heap;
+		m_HeapBytes = blockSize;
+		m_Capacity = blockSize / sizeof(T);
+	}
+
+	void resize(size_t size) {
+		if (size > m_Capacity) {
+			reserve(std::max(size, m_Capacity * 2));
+		}
+
+		if (size > m_Size) { //Match std::vector, new elements start out zeroed
+			std::memset(data() + m_Size, 0, (size - m_Size) * sizeof(T));
+		}
+
+		m_Size = size;
+	}
+
+	void assign(const T* values, size_t count) {
+		m_Size = 0;
+		append(values, count);
+	}
+
+	void append(const T* values, size_t count) {
+		if (count == 0) { //An empty string_view may hand over nullptr, which memcpy doesn't allow even for no bytes
+			return;
+		}
+
+		size_t offset = m_Size;
+		resize(m_Size + count);
+		std::memcpy(data() + offset, values, count * sizeof(T));
+	}
+
+	void push_back(const T& value) {
+		append(&value, 1);
+	}
+
+	void clear() { //Keeps the capacity so a reused buffer doesn't allocate again
+		m_Size = 0;
+	}
+
+	inline T* data() {
+		return (m_Heap) ? m_Heap : m_Inline;
+	}
+
+	inline const T* data() const {
+		return (m_Heap) ? m_Heap : m_Inline;
+	}
+
+	inline T* begin() {
+		return data();
+	}
+
+	inline T* end() {
+		return data() + m_Size;
+	}
+
+	inline const T* begin() const {
+		return data();
+	}
+
+	inline const T* end() const {
+		return data() + m_Size;
+	}
+
+	inline size_t size() const {
+		return m_Size;
+	}
+
+	inline size_t capacity() const {
+		return m_Capacity;
+	}
+
+	inline bool empty() const {
+		return m_Size == 0;
+	}
+
+	inline bool isInline() const {
+		return m_Heap == nullptr;
+	}
+
+private:
+	void Release() {
+		if (m_Heap) {
+			BufferPool::Get().Release(m_Heap, m_HeapBytes);
+			m_Heap = nullptr;
+			m_HeapBytes = 0;
+		}
+
+		m_Capacity = InlineCapacity;
+	}
+
+	//Heap storage is stolen, inline storage has to be copied over
+	void TakeFrom(PacketBuffer& other) {
+		if (other.m_Heap) {
+			m_Heap = other.m_Heap;
+			m_HeapBytes = other.m_HeapBytes;
+			m_Capacity = other.m_Capacity;
+			other.m_Heap = nullptr;
+			other.m_HeapBytes = 0;
+			other.m_Capacity = InlineCapacity;
+		}
+		else {
+			std::memcpy(m_Inline, other.m_Inline, other.m_Size * sizeof(T));
+		}
+
+		m_Size = other.m_Size;
+		other.m_Size = 0;
+	}
+
+	T m_Inline[InlineCapacity];
+	T* m_Heap = nullptr;
+	size_t m_HeapBytes = 0; //Real size of the pooled block, needed to give it back
+	size_t m_Size = 0;
+	size_t m_Capacity = InlineCapacity;
+};
\ No newline at end of file
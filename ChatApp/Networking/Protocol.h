@@ -0,0 +1,50 @@
+#pragma once
+#include "WireFormat.h"
+
+//Protocol version and optional features, agreed on during validation so wire changes can roll out gradually.
+//Version 1 clients don't know about any of this and get the original protocol with no features
+constexpr uint16_t LEGACY_PROTOCOL_VERSION = 1;
+constexpr uint16_t PROTOCOL_VERSION = 2;
+
+//Feature bits, a connection only uses the ones both sides have
+constexpr uint32_t FEATURE_COMPACT_HEADER = 1 << 0; //1 byte type + varint size header
+constexpr uint32_t FEATURE_COMPRESSION = 1 << 1; //Large bodies can be compressed
+constexpr uint32_t FEATURE_BATCHING = 1 << 2; //Several small packets can share one frame
+constexpr uint32_t FEATURE_CRC32C = 1 << 3; //Frames end in a checksum
+constexpr uint32_t FEATURE_USER_IDS = 1 << 4; //Conversation messages name users by the ID the server gave them at login
+constexpr uint32_t FEATURE_PRESENCE = 1 << 5; //Presence snapshots and deltas instead of a full online list on every change
+
+//What this build can do
+constexpr uint32_t SUPPORTED_FEATURES = FEATURE_COMPACT_HEADER | FEATURE_COMPRESSION | FEATURE_BATCHING | FEATURE_CRC32C | FEATURE_USER_IDS | FEATURE_PRESENCE;
+
+//Set in the server's validation number to say it understands hellos, and flipped in the client's answer to say
+//a hello follows it. Older clients ignore the bit and answer like before
+constexpr uint64_t HANDSHAKE_HELLO = 1ull << 62;
+
+//Sent by the client after its validation answer, the server answers with the version and features to use
+struct ProtocolHello {
+	uint16_t m_Version = LEGACY_PROTOCOL_VERSION;
+	uint32_t m_Features = 0;
+};
+
+constexpr size_t HELLO_SIZE = 6; //2 byte version + 4 byte feature bits, little endian
+
+inline void EncodeHello(const ProtocolHello& hello, uint8_t* out) {
+	StoreLE(out, hello.m_Version, 2);
+	StoreLE(out + 2, hello.m_Features, 4);
+}
+
+inline ProtocolHello DecodeHello(const uint8_t* data) {
+	ProtocolHello hello;
+	hello.m_Version = static_cast<uint16_t>(ReadLE(data, 2));
+	hello.m_Features = static_cast<uint32_t>(ReadLE(data + 2, 4));
+	return hello;
+}
+
+//Highest version both sides speak and only the features both sides have
+inline ProtocolHello AgreeOnProtocol(const ProtocolHello& local, const ProtocolHello& remote) {
+	ProtocolHello agreed;
+	agreed.m_Version = std::min(local.m_Version, remote.m_Version);
+	agreed.m_Features = local.m_Features & remote.m_Features;
+	return agreed;
+}
\ No newline at end of file
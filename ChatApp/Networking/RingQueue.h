@@ -0,0 +1,90 @@
+#pragma once
+#include "NetIncludes.h"
+
+//Queue with no locking at all, for data only ever touched from one thread (like a connection's outgoing packets,
+//which only change on its context). Items live in a power of two ring that doubles when full, so pushing and
+//popping never allocate once it has grown to the usual depth
+template<typename T>
+class RingQueue {
+public:
+	RingQueue(size_t capacity = 16) {
+		size_t size = 1;
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		m_Items.resize(size);
+	}
+
+	RingQueue(const RingQueue&) = delete;
+
+	void PushBack(T&& data) {
+		if (m_Count == m_Items.size()) {
+			Grow();
+		}
+
+		m_Items[Slot(m_Count)] = std::move(data);
+		m_Count++;
+	}
+
+	T PopFront() {
+		T item = std::move(m_Items[m_Head]);
+		m_Items[m_Head] = T(); //Let go of anything the moved from item still holds
+		m_Head = (m_Head + 1) & (m_Items.size() - 1);
+		m_Count--;
+		return item;
+	}
+
+	//Everything behind the item moves up a slot, only meant for the rare out of order removal
+	T Erase(size_t index) {
+		T item = std::move(m_Items[Slot(index)]);
+		for (size_t i = index; i + 1 < m_Count; i++) {
+			m_Items[Slot(i)] = std::move(m_Items[Slot(i + 1)]);
+		}
+
+		m_Items[Slot(m_Count - 1)] = T();
+		m_Count--;
+		return item;
+	}
+
+	void Clear() {
+		while (!isEmpty()) {
+			PopFront();
+		}
+	}
+
+	inline T& Front() {
+		return m_Items[m_Head];
+	}
+
+	inline const T& At(size_t index) const {
+		return m_Items[Slot(index)];
+	}
+
+	inline bool isEmpty() const {
+		return m_Count == 0;
+	}
+
+	inline size_t count() const {
+		return m_Count;
+	}
+
+private:
+	inline size_t Slot(size_t index) const {
+		return (m_Head + index) & (m_Items.size() - 1);
+	}
+
+	void Grow() {
+		std::vector<T> items(m_Items.size() * 2);
+		for (size_t i = 0; i < m_Count; i++) {
+			items[i] = std::move(m_Items[Slot(i)]);
+		}
+
+		m_Items.swap(items);
+		m_Head = 0;
+	}
+
+	std::vector<T> m_Items;
+	size_t m_Head = 0;
+	size_t m_Count = 0;
+};
\ No newline at end of file
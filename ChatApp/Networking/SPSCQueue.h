@@ -0,0 +1,68 @@
+#pragma once
+#include "MPMCQueue.h"
+
+//Bounded lock free queue for exactly one producer thread and one consumer thread (Lamport's ring). Each side only
+//ever writes its own position, so a push or pop is a plain store with no compare and swap. Both sides keep a copy of
+//the other's position and only go back to the real one when the ring looks full or empty, keeping them off each
+//other's cache line most of the time
+template<typename T>
+class SPSCQueue {
+public:
+	SPSCQueue(size_t capacity = 1024) {
+		size_t size = 2;
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		m_Mask = size - 1;
+		m_Slots.reset(new T[size]);
+	}
+
+	SPSCQueue(const SPSCQueue&) = delete;
+
+	//Producer only. Returns false without touching data if the queue is full
+	bool TryPushBack(T&& data) {
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+
+		if (tail - m_CachedHead > m_Mask) {
+			m_CachedHead = m_Head.load(std::memory_order_acquire);
+			if (tail - m_CachedHead > m_Mask) {
+				return false;
+			}
+		}
+
+		m_Slots[tail & m_Mask] = std::move(data);
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer only
+	bool TryPopFront(T& out) {
+		size_t head = m_Head.load(std::memory_order_relaxed);
+
+		if (head == m_CachedTail) {
+			m_CachedTail = m_Tail.load(std::memory_order_acquire);
+			if (head == m_CachedTail) {
+				return false;
+			}
+		}
+
+		out = std::move(m_Slots[head & m_Mask]);
+		m_Slots[head & m_Mask] = T(); //Let go of anything the moved from item still holds
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Only a snapshot unless called from the consumer
+	bool isEmpty() const {
+		return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+	}
+
+private:
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_Head{ 0 }; //Consumer's line
+	size_t m_CachedTail = 0;
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_Tail{ 0 }; //Producer's line
+	size_t m_CachedHead = 0;
+	alignas(CACHE_LINE_SIZE) std::unique_ptr<T[]> m_Slots;
+	size_t m_Mask;
+};
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Connection.h"
+#include "Shard.h"
 #include <unordered_map>
 
 struct ChatParty {
@@ -10,12 +11,28 @@ struct ChatParty {
 	std::shared_ptr<Connection> m_RecUser; //The user who got invited to chat
 };
 
+//Where the server handles the packets its connections read
+enum class DispatchMode {
+	Queue, //Packets wait in the incoming queue until Update() handles them on whatever thread calls it
+	Strand, //Packets are handled on the context as soon as they're read, through one strand so handlers never overlap. No Update() needed
+	Sharded //Users are split across worker shards that each handle their own users' packets, see Shard.h. Only chat messages run on the shards in parallel, everything else still takes m_StateMutex. No Update() needed
+};
+
 class Server {
 public:
-	Server(uint16_t port) 
-		:m_ASIOAcceptor(m_Context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+	//threadCount threads run the context. Each connection's handlers go through its own strand so they never overlap,
+	//while different connections' reads and writes run in parallel. shardCount is only used by DispatchMode::Sharded
+	Server(uint16_t port, DispatchMode mode = DispatchMode::Queue, size_t threadCount = 1, size_t shardCount = 1)
+		:m_ASIOAcceptor(m_Context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)), m_DispatchMode(mode), m_ThreadCount(std::max<size_t>(threadCount, 1))
 	{
-		//holder
+		if (m_DispatchMode == DispatchMode::Sharded) {
+			shardCount = std::max<size_t>(shardCount, 1);
+			for (size_t i = 0; i < shardCount; i++) {
+				m_Shards.push_back(std::make_unique<Shard>(i, shardCount, [this](OwnedPacket& packet) {
+					HandlePacket(packet);
+				}));
+			}
+		}
 	}
 
 	~Server() {
@@ -35,8 +52,13 @@ public:
 
 			//Start running the server connection. Prime it to listen to incoming connections and handle them.
 			ListenForConnections();
+			for (auto& shard : m_Shards) {
+				shard->Start();
+			}
 			//Listen for connections first before running the context so it dosen't exit right away. Keep the context busy
-			m_ContextThread = std::thread([this]() {m_Context.run(); });
+			for (size_t i = 0; i < m_ThreadCount; i++) {
+				m_ContextThreads.emplace_back([this]() {m_Context.run(); });
+			}
 		}
 		catch (const std::exception& e) {
 			std::cout << "Server Start Failed! Exception Thrown: " << e.what() << std::endl;
@@ -49,36 +71,81 @@ public:
 	}
 
 	void Stop() {
-		for (auto& client : m_Connections) {
-			client->Disconnect();
+		{
+			std::lock_guard<std::mutex> lock(m_StateMutex);
+			for (auto& client : m_Connections) {
+				client->Disconnect();
+			}
 		}
 
 		m_Context.stop();
 
-		if (m_ContextThread.joinable()) {
-			m_ContextThread.join();
+		for (auto& thread : m_ContextThreads) {
+			if (thread.joinable()) {
+				thread.join();
+			}
+		}
+
+		for (auto& shard : m_Shards) {
+			shard->Stop();
 		}
 
+		BufferPoolStats poolStats = BufferPool::Get().getStats();
+		std::string poolSummary = "Buffer Pool Hits: " + std::to_string(poolStats.m_Hits) + " Misses: " + std::to_string(poolStats.m_Misses)
+			+ " Oversized: " + std::to_string(poolStats.m_Oversized) + " Freed: " + std::to_string(poolStats.m_Freed);
+		std::cout << poolSummary << std::endl;
+		WriteToLog(poolSummary);
+
+		std::string checksumSummary = "Frames Failing Their Checksum: " + std::to_string(ChecksumFailures().load());
+		std::cout << checksumSummary << std::endl;
+		WriteToLog(checksumSummary);
+
 		std::cout << "The Server Has Stopped Running" << std::endl;
 		WriteToLog("The Server Has Stopped Running");
 	}
 
+	void SetConnectionLimits(const ConnectionLimits& limits) { //Applies to connections accepted after the call
+		m_Limits = limits;
+	}
+
 	void ListenForConnections() {
-		m_ASIOAcceptor.async_accept([this](std::error_code ec, asio::ip::tcp::socket socket) {
+		//Every accepted socket gets its own strand, all of its handlers run through it
+		m_ASIOAcceptor.async_accept(asio::make_strand(m_Context), [this](std::error_code ec, asio::ip::tcp::socket socket) {
+			std::lock_guard<std::mutex> lock(m_StateMutex);
+			ReapConnections();
+
 			if (!ec) {
 				std::cout << "New Connection With Client: " << socket.remote_endpoint() << std::endl;
 				WriteToLog("New Connection With Client");
 				std::shared_ptr<Connection> newConnection = std::make_shared<Connection>(m_Context, std::move(socket), m_IncomingPackets);
+				newConnection->SetLimits(m_Limits);
+
+				SlabHandle handle = (OnClientConnect(newConnection)) ? m_Connections.Insert(std::shared_ptr<Connection>(newConnection)) : INVALID_SLAB_HANDLE;
+				if (handle == INVALID_SLAB_HANDLE) {
+					std::cout << "Connection Refused, Server Full or Client Not Allowed" << std::endl;
+					WriteToLog("Connection Refused, Server Full or Client Not Allowed");
+					newConnection->Disconnect();
+					ListenForConnections();
+					return;
+				}
 
-				if (OnClientConnect(newConnection)) {
-					m_Connections.push_back(std::move(newConnection));
-					m_Connections.back()->ConnectToClient(++m_UserIndex, m_IDCounter++);
-					std::cout << m_Connections.back()->getID() << " Connection Approved" << std::endl;
-					WriteToLog(std::to_string(m_Connections.back()->getID()) + " Connection Approved");
+				if (m_DispatchMode == DispatchMode::Strand) {
+					newConnection->SetPacketHandler([this](OwnedPacket&& packet) {
+						asio::post(m_DispatchStrand, [this, packet = std::move(packet)]() mutable {
+							HandlePacket(packet);
+						});
+					});
 				}
-				else {
-					socket.close();
+				else if (m_DispatchMode == DispatchMode::Sharded) {
+					Shard* shard = m_Shards[ShardOf(handle)].get();
+					newConnection->SetPacketHandler([shard](OwnedPacket&& packet) {
+						shard->Post(std::move(packet));
+					});
 				}
+
+				newConnection->ConnectToClient(handle, m_IDCounter++);
+				std::cout << newConnection->getID() << " Connection Approved" << std::endl;
+				WriteToLog(std::to_string(newConnection->getID()) + " Connection Approved");
 			}
 			else {
 				std::cout << "Error Connecting to Client: " << ec.message();
@@ -89,10 +156,11 @@ public:
 		});
 	}
 
+	//Only takes the client out of the directory. The connection itself leaves m_Connections in ReapConnections(), as
+	//this gets called while m_Connections is being walked
 	bool RemoveClient(std::shared_ptr<Connection> client) {
-		//Not the solution I would like as now m_Connection is filled with redundent connections; but
-		//trying to remove it from the queue results in the program crashing.
-		if (m_Directory.find(client->getAccount().m_AccUser) == m_Directory.end()) {
+		auto entry = m_Directory.find(client->getAccount().m_AccUser);
+		if (entry == m_Directory.end() || entry->second != client->getHandle()) {
 			std::cout << "The Username " << client->getAccount().m_AccUser << " Was Not Found During the Removal Process" << std::endl;
 			WriteToLog("The Username " + client->getAccount().m_AccUser + " Was Not Found During the Removal Process");
 			return false;
@@ -101,22 +169,53 @@ public:
 			std::cout << "The User " << client->getAccount().m_AccUser << " Has Been Removed" << std::endl;
 			WriteToLog("The User " + client->getAccount().m_AccUser + " Has Been Removed");
 			OnClientDisconnect(client->getAccount().m_AccUser);
-			m_Directory.erase(client->getAccount().m_AccUser);
+			m_Directory.erase(entry);
+			PublishPresence(PresenceChange::Leave, client);
 			return true;
 		}
 	}
 
-	bool MessageClient(std::string username, const Packet& packet) {
-		std::shared_ptr<Connection> client = m_Connections[m_Directory[username]];
+	//Drops connections that are closed or were let go of, unless they're still in the directory. Those get found and
+	//removed the next time something fails to send to them. A dropped connection's socket is closed on the way out
+	void ReapConnections() {
+		m_Connections.EraseIf([this](const std::shared_ptr<Connection>& client) {
+			if (client->isConnected() && client->getID() != 0) {
+				return false;
+			}
+
+			auto entry = m_Directory.find(client->getAccount().m_AccUser);
+			if (entry != m_Directory.end() && entry->second == client->getHandle()) {
+				return false;
+			}
+
+			client->Disconnect();
+			return true;
+		});
+	}
+
+	//nullptr if the user isn't online
+	std::shared_ptr<Connection> FindClient(const std::string& username) {
+		auto entry = m_Directory.find(username);
+		if (entry == m_Directory.end()) {
+			return nullptr;
+		}
+
+		std::shared_ptr<Connection>* client = m_Connections.Get(entry->second);
+		return (client) ? *client : nullptr;
+	}
+
+	//Takes the packet by value so callers handing over a temporary or std::move'd packet never copy it
+	bool MessageClient(std::string username, Packet packet) {
+		std::shared_ptr<Connection> client = FindClient(username);
 
 		if (client && client->isConnected()) {
-			client->Send(packet);
+			client->Send(std::move(packet));
 			return true;
 		}
 		else {
 			std::cout << "Failed Sending Packet To " << username << std::endl;
 			WriteToLog("Failed Sending Packet to " + username);
-			if (RemoveClient(client)) {
+			if (client && RemoveClient(client)) {
 				client->IgnoreConnection(); //Not in RemoveClient as this overwrites username which may still be needed to log etc
 				client.reset();
 				SendOnlineList();
@@ -126,206 +225,368 @@ public:
 		}
 	}
 
-	void MessageAll(const Packet& packet, std::shared_ptr<Connection> ignoreClient = nullptr) {
-		for (const auto& client : m_Directory) {
-			std::shared_ptr<Connection> curClient = m_Connections[client.second];
+	//Only clients that agreed on every feature in requiredFeatures get it
+	void MessageAll(const Packet& packet, std::shared_ptr<Connection> ignoreClient = nullptr, uint32_t requiredFeatures = 0) {
+		//Built (and compressed if large) once, every recipient only queues a pointer to it
+		SharedPacket sharedPacket = SharePacket(Packet(packet), true);
+		std::vector<std::shared_ptr<Connection>> failedClients; //Removed after the loop, removing edits m_Directory
 
-			if (curClient && curClient->isConnected() && curClient != ignoreClient) {
-				curClient->Send(packet);
+		for (const auto& entry : m_Directory) {
+			std::shared_ptr<Connection>* curClient = m_Connections.Get(entry.second);
+
+			if (curClient && (*curClient == ignoreClient || ((*curClient)->getFeatures() & requiredFeatures) != requiredFeatures)) {
+				continue;
 			}
-			else {
-				if (curClient != ignoreClient) {
-					std::cout << "Failed Sending Packet To " << curClient->getAccount().m_AccUser << std::endl;
-					WriteToLog("Failed Sending Packet to " + curClient->getAccount().m_AccUser);
-					if (RemoveClient(curClient)) {
-						curClient->IgnoreConnection();
-						curClient.reset();
-						SendOnlineList();
-					}
-				}
+
+			if (curClient && (*curClient)->isConnected()) {
+				(*curClient)->Send(sharedPacket);
+			}
+			else if (curClient) {
+				std::cout << "Failed Sending Packet To " << entry.first << std::endl;
+				WriteToLog("Failed Sending Packet to " + entry.first);
+				failedClients.push_back(*curClient);
+			}
+		}
+
+		for (auto& failedClient : failedClients) {
+			if (RemoveClient(failedClient)) {
+				failedClient->IgnoreConnection();
+				SendOnlineList();
 			}
 		}
 	}
 
 	void Update(int maxRead = -1, bool wait = false) {
-		if (wait) {
-			m_IncomingPackets.Wait();
+		if (m_DispatchMode != DispatchMode::Queue) { //Nothing ever reaches the queue, the strand or the shards handle it all
+			return;
+		}
+
+		//The whole backlog is taken in one lock, whatever a capped call doesn't get to is handled first next time
+		if (m_PendingPackets.empty()) {
+			if (wait) {
+				m_IncomingPackets.Wait();
+			}
+
+			m_IncomingPackets.PopAll(m_PendingPackets);
 		}
 
 		int packetCount = 0;
-		while (maxRead < packetCount && !m_IncomingPackets.isEmpty()) {
-			OwnedPacket packet = m_IncomingPackets.PopFront();
-			OnMessage(packet.m_Owner, packet.m_Packet);
+		while ((maxRead < 0 || packetCount < maxRead) && !m_PendingPackets.empty()) {
+			OwnedPacket packet = std::move(m_PendingPackets.front());
+			m_PendingPackets.pop_front();
+			HandlePacket(packet);
 			packetCount++;
 		}
 	}
 
+	void HandlePacket(OwnedPacket& packet) {
+		PacketType type = packet.m_Packet.m_Header.m_ID;
+		if (type == PacketType::Message || type == PacketType::UserMessage) { //Only touches the conversations of the shard it's on, no lock
+			OnMessage(packet.m_Owner, packet.m_Packet);
+		}
+		else {
+			std::lock_guard<std::mutex> lock(m_StateMutex);
+			OnMessage(packet.m_Owner, packet.m_Packet);
+		}
+
+		if (packet.m_Owner) { //Lets the connection read again if it was paused waiting on us
+			packet.m_Owner->ReleaseInbound();
+		}
+	}
+
+	using MessageHandler = void (Server::*)(std::shared_ptr<Connection>&, Packet&);
+
+	static constexpr std::array<MessageHandler, PACKET_TYPE_COUNT> MakeHandlerTable() {
+		std::array<MessageHandler, PACKET_TYPE_COUNT> table{};
+		Register<AccountInfoMsg, &Server::OnAccountInfo>(table);
+		Register<ChangePasswordMsg, &Server::OnChangePassword>(table);
+		Register<ValidatedMsg, &Server::OnValidated>(table);
+		Register<ChatRequestMsg, &Server::OnChatRequest>(table);
+		Register<ChatAlertResponseMsg, &Server::OnChatAlertResponse>(table);
+		Register<ChatMsg, &Server::OnChatMessage>(table);
+		Register<UserChatMsg, &Server::OnUserChatMessage>(table);
+		Register<PresenceResyncMsg, &Server::OnPresenceResync>(table);
+		Register<LeaveConvoMsg, &Server::OnLeaveConvo>(table);
+		Register<ClientExitMsg, &Server::OnClientExit>(table);
+		Register<BackpressureMsg, &Server::OnBackpressure>(table);
+		return table;
+	}
+
+	template<typename Message, void (Server::*Handler)(std::shared_ptr<Connection>&, const Message&)>
+	static constexpr void Register(std::array<MessageHandler, PACKET_TYPE_COUNT>& table) {
+		table[static_cast<size_t>(Message::Type)] = &Server::Dispatch<Message, Handler>;
+	}
+
+	template<typename Message, void (Server::*Handler)(std::shared_ptr<Connection>&, const Message&, Packet&)>
+	static constexpr void Register(std::array<MessageHandler, PACKET_TYPE_COUNT>& table) {
+		table[static_cast<size_t>(Message::Type)] = &Server::Dispatch<Message, Handler>;
+	}
+
 	void OnMessage(std::shared_ptr<Connection> client, Packet& packet) {
-		switch (packet.m_Header.m_ID) {
-			case PacketType::AccountInfo: {
-				HandleAccount(client);
-				break;
-			}
+		//Built at compile time, one slot per packet type
+		static constexpr std::array<MessageHandler, PACKET_TYPE_COUNT> handlers = MakeHandlerTable();
 
-			case PacketType::ChangePassword: {
-				std::string str, user, newPass;
-				packet >> str;
-				user = str.substr(0, str.find("#"));
-				newPass = str.substr(str.find("#") + 1, str.size());
-				ChangePassword(user, newPass);
-				break;
-			}
+		size_t type = static_cast<size_t>(packet.m_Header.m_ID);
+		if (type < handlers.size() && handlers[type] != nullptr) {
+			(this->*handlers[type])(client, packet);
+		}
+		else {
+			std::cout << "Packet Type Unknown! Packet Information:" << std::endl;
+			std::cout << packet << std::endl;
+			WriteToLog("Packet Type Unknown! Header Number: " + std::to_string((int)packet.m_Header.m_ID));
+		}
+	}
 
-			case PacketType::Validated: {
-				int validationResult;
-				packet >> validationResult;
-				OnClientValidated(client->getID(), static_cast<bool>(validationResult));
-				break;
-			}
+	//Decodes the body into the message type for the handler, the message's strings point into the packet
+	template<typename Message, void (Server::*Handler)(std::shared_ptr<Connection>&, const Message&)>
+	void Dispatch(std::shared_ptr<Connection>& client, Packet& packet) {
+		Message message;
 
-			case PacketType::ChatRequest: {
-				std::string receiver;
-				packet >> receiver;
+		if (DecodeMessage(packet, message)) {
+			(this->*Handler)(client, message);
+		}
+		else {
+			MalformedPacket(client, packet);
+		}
+	}
 
-				HandleChatRequest(client, receiver);
-				break;
-			}
+	//Same, for handlers that may take the packet over once they're done with the message, like relaying it on
+	template<typename Message, void (Server::*Handler)(std::shared_ptr<Connection>&, const Message&, Packet&)>
+	void Dispatch(std::shared_ptr<Connection>& client, Packet& packet) {
+		Message message;
 
-			case PacketType::ChatAlertResponse: {
-				std::string response;
-				packet >> response;
+		if (DecodeMessage(packet, message)) {
+			(this->*Handler)(client, message, packet);
+		}
+		else {
+			MalformedPacket(client, packet);
+		}
+	}
 
-				std::string rec, init, accpt;
-				size_t firstHash = response.find(":");
+	void MalformedPacket(const std::shared_ptr<Connection>& client, const Packet& packet) {
+		std::cout << "Malformed Packet From ID: " << client->getID() << " Packet Information:" << std::endl;
+		std::cout << packet << std::endl;
+		WriteToLog("Malformed Packet From ID: " + std::to_string(client->getID()) + " Header Number: " + std::to_string((int)packet.m_Header.m_ID));
+	}
 
-				//Extract the data
-				rec = response.substr(0, firstHash);
-				init = response.substr(firstHash + 1, (response.find_last_of(":") - firstHash) - 1);
-				accpt = response.substr(response.find_last_of(":") + 1, response.size());
+	void OnAccountInfo(std::shared_ptr<Connection>& client, const AccountInfoMsg&) {
+		client->TakeAccount();
+		HandleAccount(client);
+	}
 
-				HandleChatAlertResponse(init, rec, (accpt == "t") ? true : false);
-				break;
-			}
+	void OnChangePassword(std::shared_ptr<Connection>&, const ChangePasswordMsg& message) {
+		ChangePassword(std::string(message.m_User), std::string(message.m_NewPassword));
+	}
 
-			case PacketType::Message: {
-				std::string msg;
-				packet >> msg;
-				ProcessMessage(msg);
-				break;
-			}
+	void OnValidated(std::shared_ptr<Connection>& client, const ValidatedMsg& message) {
+		OnClientValidated(client->getID(), message.m_Result != 0);
 
-			case PacketType::LeaveConvo: {
-				std::string user;
-				packet >> user;
-				LeavingConvo(user);
-				break;
-			}
+		if (message.m_Result != 0) {
+			std::cout << "Client ID: " << client->getID() << " Uses Protocol Version " << client->getProtocolVersion() << " With Features " << client->getFeatures() << std::endl;
+			WriteToLog("Client ID: " + std::to_string(client->getID()) + " Uses Protocol Version " + std::to_string(client->getProtocolVersion()) + " With Features " + std::to_string(client->getFeatures()));
+		}
+		else {
+			client->IgnoreConnection();
+		}
+	}
 
-			case PacketType::ClientExit: {
-				if (client->m_Status == ChatStatus::Chatting) {
-					LeavingConvo(client->getAccount().m_AccUser);
-				}
+	//What happens to the queued packets is up to the connection's SlowConsumerPolicy, this only keeps a record
+	void OnBackpressure(std::shared_ptr<Connection>& client, const BackpressureMsg& message) {
+		std::string state = (message.m_Congested) ? " Is Not Keeping Up, " : " Caught Up, ";
+		std::string summary = "ID: " + std::to_string(client->getID()) + state + std::to_string(message.m_QueuedBytes) + " Bytes Queued";
+		std::cout << summary << std::endl;
+		WriteToLog(summary);
+	}
 
-				std::cout << "The User " << client->getAccount().m_AccUser << " Has Left" << std::endl;
-				WriteToLog("The User " + client->getAccount().m_AccUser + " Has Left");
-				RemoveClient(client);
-				client->IgnoreConnection();
-				client.reset();
+	void OnChatRequest(std::shared_ptr<Connection>& client, const ChatRequestMsg& message) {
+		HandleChatRequest(client, std::string(message.m_Receiver));
+	}
 
-				if (m_Directory.size() != 0) {
-					SendOnlineList();
-				}
-				break;
-			}
+	void OnChatAlertResponse(std::shared_ptr<Connection>&, const ChatAlertResponseMsg& message) {
+		HandleChatAlertResponse(std::string(message.m_Initiator), std::string(message.m_Receiver), message.m_Accepted);
+	}
 
-			default: {
-				std::cout << "Packet Type Unknown! Packet Information:" << std::endl;
-				std::cout << packet << std::endl;
-				WriteToLog("Packet Type Unknown! Header Number: " + std::to_string((int)packet.m_Header.m_ID));
-				break;
-			}
+	void OnChatMessage(std::shared_ptr<Connection>& client, const ChatMsg& message, Packet& packet) {
+		ProcessMessage(client, message.m_Text, packet);
+	}
+
+	void OnUserChatMessage(std::shared_ptr<Connection>& client, const UserChatMsg& message, Packet& packet) {
+		std::shared_ptr<Connection> partner = client->getPartner();
+
+		if (partner && partner->getUserID() == message.m_User) { //Stale IDs from a conversation that already ended go nowhere
+			ProcessMessage(client, message.m_Text, packet);
 		}
 	}
 
-	void LeavingConvo(const std::string& user, unsigned int presignedIndex = -1, std::string receiver = "") {
-		unsigned int index = presignedIndex;
+	void OnPresenceResync(std::shared_ptr<Connection>& client, const PresenceResyncMsg&) {
+		if (client->isApproved()) {
+			SendPresenceSnapshot(client);
+		}
+	}
 
-		if (presignedIndex == -1) { //Not set by ProcessMessage failure, have to find it
-			for (unsigned int i = 0; i < m_OngoingConversations.count(); i++) {
-				if (m_OngoingConversations[i].m_InitUser->getAccount().m_AccUser == user) {
-					index = i;
-					receiver = m_OngoingConversations[i].m_RecUser->getAccount().m_AccUser;
-					break;
-				}
-				else if (m_OngoingConversations[i].m_RecUser->getAccount().m_AccUser == user) {
-					index = i;
-					receiver = m_OngoingConversations[i].m_InitUser->getAccount().m_AccUser;
-					break;
-				}
-			}
+	void OnLeaveConvo(std::shared_ptr<Connection>& client, const LeaveConvoMsg&) {
+		LeavingConvo(client);
+	}
+
+	void OnClientExit(std::shared_ptr<Connection>& client, const ClientExitMsg&) {
+		if (client->m_Status == ChatStatus::Chatting) {
+			LeavingConvo(client);
 		}
 
+		std::cout << "The User " << client->getAccount().m_AccUser << " Has Left" << std::endl;
+		WriteToLog("The User " + client->getAccount().m_AccUser + " Has Left");
+		RemoveClient(client);
+		client->IgnoreConnection();
+		client->Disconnect();
+		client.reset();
+		ReapConnections();
+
+		if (m_Directory.size() != 0) {
+			SendOnlineList();
+		}
+	}
+
+	void LeavingConvo(std::shared_ptr<Connection> leaver) {
+		std::shared_ptr<Connection> partner = leaver->getPartner();
+
+		if (partner) {
+			EndConversation(leaver, partner, leaver->getAccount().m_AccUser);
+		}
+	}
+
+	//The partner gets told the leaver is gone. user is the leaver's name, passed in as it may already be wiped
+	void EndConversation(const std::shared_ptr<Connection>& leaver, const std::shared_ptr<Connection>& partner, const std::string& user) {
+		std::string receiver = partner->getAccount().m_AccUser;
+
 		std::cout << user << " is Leaving the Conversation With " << receiver << std::endl;
 		WriteToLog(user + " is Leaving the Conversation With " + receiver);
 
-		m_OngoingConversations[index].m_InitUser->m_Status = ChatStatus::Open;
-		m_OngoingConversations[index].m_RecUser->m_Status = ChatStatus::Open;
-		m_OngoingConversations.Erase(index);
+		leaver->m_Status = ChatStatus::Open;
+		partner->m_Status = ChatStatus::Open;
+		PublishPresence(PresenceChange::Status, leaver);
+		PublishPresence(PresenceChange::Status, partner);
+		ForEachInParty(ChatParty(leaver, partner), [](const std::shared_ptr<Connection>& self, const std::shared_ptr<Connection>& other) {
+			if (self->getPartner() == other) { //Unless they've already moved on to someone else
+				self->SetPartner({});
+			}
+		});
 
-		Packet leaveMessage(PacketType::LeaveConvo);
-		MessageClient(receiver, leaveMessage);
+		MessageClient(receiver, EncodeMessage(LeaveConvoMsg{ user }));
 	}
 
-	void ProcessMessage(const std::string& str) {
-		std::string sender = str.substr(0, str.find(":"));
-		std::string fullMsg = str.substr(str.find(":") + 1, str.size());
+	//The hot path. Never takes the state lock, the partner handle is only touched on the shard handling the sender.
+	//The sender is named by the connection the message came in on, not by anything in it. text points into received,
+	//which is passed on as it is when the partner reads the same layout
+	void ProcessMessage(const std::shared_ptr<Connection>& client, std::string_view text, Packet& received) {
+		std::shared_ptr<Connection> partner = client->getPartner();
+		if (!partner) {
+			return;
+		}
 
-		std::string receiver = "";
-		unsigned int index = -1;
-		for (unsigned int i = 0; i < m_OngoingConversations.count(); i++) {
-			if (m_OngoingConversations[i].m_InitUser->getAccount().m_AccUser == sender) {
-				index = i;
-				receiver = m_OngoingConversations[i].m_RecUser->getAccount().m_AccUser;
-				break;
-			}
-			else if (m_OngoingConversations[i].m_RecUser->getAccount().m_AccUser == sender) {
-				index = i;
-				receiver = m_OngoingConversations[i].m_InitUser->getAccount().m_AccUser;
-				break;
+		if (partner->isConnected()) {
+			partner->Send(EncodeChatMessage(client, partner, text, received));
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_StateMutex);
+		std::string receiver = partner->getAccount().m_AccUser;
+		if (!MessageClient(receiver, EncodeChatMessage(client, partner, text, received))) {
+			EndConversation(partner, client, receiver);
+		}
+	}
+
+	//Partners that know the sender's ID get just that, older ones get the username. When the partner reads the same
+	//message type the sender sent, only the sender field is rewritten and the body goes on in the buffer it came in
+	Packet EncodeChatMessage(const std::shared_ptr<Connection>& sender, const std::shared_ptr<Connection>& receiver, std::string_view text, Packet& received) {
+		PacketType type = received.m_Header.m_ID;
+
+		if (receiver->getFeatures() & FEATURE_USER_IDS) {
+			if (type == PacketType::UserMessage && ReplaceFirstField(received, sender->getUserID())) {
+				return std::move(received);
 			}
+
+			return EncodeMessage(UserChatMsg{ sender->getUserID(), text });
+		}
+
+		if (type == PacketType::Message && ReplaceFirstField(received, std::string_view(sender->getChatName()))) {
+			return std::move(received);
 		}
 
-		Packet msgPacket(PacketType::Message);
-		msgPacket << fullMsg;
+		return EncodeMessage(ChatMsg{ sender->getChatName(), text });
+	}
 
-		if (!MessageClient(receiver, msgPacket)) {
-			LeavingConvo(receiver, index, sender);
+	//Tells the client which ID a user goes by before it first hears about them, only clients addressing users by ID need it
+	void SendUserInfo(const std::shared_ptr<Connection>& to, const std::shared_ptr<Connection>& about) {
+		if (to->getFeatures() & FEATURE_USER_IDS) {
+			to->Send(EncodeMessage(UserInfoMsg{ about->getUserID(), about->getAccount().m_AccUser }));
 		}
 	}
 
+	//Each user's partner handle is set on the shard that owns them. The names are read here, under the state lock
+	void StartConversation(const ChatParty& party) {
+		std::shared_ptr<Connection> init = party.m_InitUser;
+		std::string initName = init->getAccount().m_AccUser, recName = party.m_RecUser->getAccount().m_AccUser;
+
+		ForEachInParty(party, [init, initName, recName](const std::shared_ptr<Connection>& self, const std::shared_ptr<Connection>& other) {
+			self->SetPartner(other, (self == init) ? initName : recName);
+		});
+	}
+
+	//Runs the task once for each user in the party, with the other as the second argument, on that user's shard
+	void ForEachInParty(const ChatParty& party, const std::function<void(const std::shared_ptr<Connection>&, const std::shared_ptr<Connection>&)>& task) {
+		std::shared_ptr<Connection> first = party.m_InitUser, second = party.m_RecUser;
+
+		RunOnShard(ShardOf(first->getHandle()), [task, first, second]() { task(first, second); });
+		RunOnShard(ShardOf(second->getHandle()), [task, first, second]() { task(second, first); });
+	}
+
+	//Runs the task on the thread that owns the shard's state: right away if that's the calling thread, otherwise through
+	//the shard's mailbox. Without shards everything is shard 0 and runs right away
+	void RunOnShard(size_t shard, Shard::Task&& task) {
+		Shard* current = Shard::Current();
+
+		if (current == nullptr || current->getIndex() == shard) {
+			task();
+		}
+		else {
+			m_Shards[shard]->Mail(*current, std::move(task));
+		}
+	}
+
+	size_t ShardOf(SlabHandle handle) const {
+		return (m_Shards.empty()) ? 0 : handle % m_Shards.size();
+	}
+
+	size_t CurrentShard() const {
+		Shard* current = Shard::Current();
+		return (current) ? current->getIndex() : 0;
+	}
+
 	void HandleChatAlertResponse(const std::string& init, const std::string& rec, bool accepted) {
 		//Find the ChatParty in the possible pool of chatting connections
-		size_t index = 0;
-		for (unsigned int i = 0; i < m_PossibleParty.count(); i++) {
+		size_t index = m_PossibleParty.size();
+		for (size_t i = 0; i < m_PossibleParty.size(); i++) {
 			if (m_PossibleParty[i].m_InitUser->getAccount().m_AccUser == init && m_PossibleParty[i].m_RecUser->getAccount().m_AccUser == rec) {
 				index = i;
 				break;
 			}
 		}
 
-		if (index == -1) {
+		if (index == m_PossibleParty.size()) {
 			std::cout << "Unable to Find the Party For " << init << " and " << rec << std::endl;
 			WriteToLog("Unable to Find the Party For " + init + " and " + rec);
+			return;
 		}
 		
-		if (!m_Connections[m_Directory[init]] || !m_Connections[m_Directory[init]]->isConnected()) {
+		std::shared_ptr<Connection> initiator = FindClient(init);
+		if (!initiator || !initiator->isConnected()) {
 			std::cout << "User " << init << " Was Unable to be Reached During the Alert Process" << std::endl;
 			WriteToLog("User " + init + " Was Unable to be Reached During the Alert Process");
-			Packet unreachlePacket(PacketType::ChatResponse);
-			std::string msg = init + ":" + std::to_string(4);
-			m_PossibleParty.Erase(index);
-			MessageClient(rec, unreachlePacket);
-			RemoveClient(m_Connections[m_Directory[init]]);
+			m_PossibleParty.erase(m_PossibleParty.begin() + index);
+			MessageClient(rec, EncodeMessage(ChatResponseMsg{ init, 4 }));
+			if (initiator) {
+				RemoveClient(initiator);
+			}
 			SendOnlineList();
 		}
 		else {
@@ -338,50 +599,39 @@ public:
 				std::cout << m_PossibleParty[index].m_InitUser->getAccount().m_AccUser << " is Now Chatting With " << m_PossibleParty[index].m_RecUser->getAccount().m_AccUser << std::endl;
 				WriteToLog(m_PossibleParty[index].m_InitUser->getAccount().m_AccUser + " is Now Chatting With " + m_PossibleParty[index].m_RecUser->getAccount().m_AccUser);
 
-				m_OngoingConversations.PushBack(m_PossibleParty[index]);
-				Packet acceptPacket(PacketType::ChatResponse);
-				acceptPacket << std::string(rec + ":" + std::to_string(0));
+				StartConversation(m_PossibleParty[index]);
+				PublishPresence(PresenceChange::Status, m_PossibleParty[index].m_InitUser);
+				PublishPresence(PresenceChange::Status, m_PossibleParty[index].m_RecUser);
+				SendUserInfo(m_PossibleParty[index].m_InitUser, m_PossibleParty[index].m_RecUser);
 				SendOnlineList(); //Sending it here first as the connection reads packet from the Front(), allows chatting bool in main to hold true
-				MessageClient(init, acceptPacket);
+				MessageClient(init, EncodeMessage(ChatResponseMsg{ rec, 0 }));
 			}
 			else {
-				Packet rejectPacket(PacketType::ChatResponse);
-				rejectPacket << std::string(rec + ":" + std::to_string(5));
-				MessageClient(init, rejectPacket);
+				MessageClient(init, EncodeMessage(ChatResponseMsg{ rec, 5 }));
 			}
 
-			m_PossibleParty.Erase(index);
+			m_PossibleParty.erase(m_PossibleParty.begin() + index);
 		}
 	}
 
 	void HandleChatRequest(std::shared_ptr<Connection> client, const std::string& receiver) {
-		if (m_Connections.size() == 1) { //User is alone, no one to connect to
-			Packet rejectRequest(PacketType::ChatResponse);
-			rejectRequest << std::string(receiver + ":" + std::to_string(1));
-			MessageClient(client->getAccount().m_AccUser, rejectRequest);
+		if (m_Connections.count() == 1) { //User is alone, no one to connect to
+			MessageClient(client->getAccount().m_AccUser, EncodeMessage(ChatResponseMsg{ receiver, 1 }));
 		}
 		else if (m_Directory.find(receiver) == m_Directory.end() || receiver == "$invalid") { //Can't find user
-			Packet rejectRequest(PacketType::ChatResponse);
-			rejectRequest << std::string(receiver + ":" + std::to_string(2));
-			MessageClient(client->getAccount().m_AccUser, rejectRequest);
+			MessageClient(client->getAccount().m_AccUser, EncodeMessage(ChatResponseMsg{ receiver, 2 }));
 		}
-		else if (m_Connections[m_Directory[receiver]]->m_Status == ChatStatus::Chatting) { //User is chatting
-			Packet rejectRequest(PacketType::ChatResponse);
-			rejectRequest << std::string(receiver + ":" + std::to_string(3));
-			MessageClient(client->getAccount().m_AccUser, rejectRequest);
+		else if (FindClient(receiver)->m_Status == ChatStatus::Chatting) { //User is chatting
+			MessageClient(client->getAccount().m_AccUser, EncodeMessage(ChatResponseMsg{ receiver, 3 }));
 		}
 		else {
-			ChatParty party(m_Connections[m_Directory[client->getAccount().m_AccUser]], m_Connections[m_Directory[receiver]]);
-			Packet alertReciever(PacketType::ChatAlert);
-			alertReciever << client->getAccount().m_AccUser;
-
-			if (!MessageClient(receiver, alertReciever)) {
-				Packet rejectRequest(PacketType::ChatResponse);
-				rejectRequest << std::string(receiver + ":" + std::to_string(4));
-				MessageClient(client->getAccount().m_AccUser, rejectRequest);
+			ChatParty party(client, FindClient(receiver));
+			SendUserInfo(party.m_RecUser, client);
+			if (!MessageClient(receiver, EncodeMessage(ChatAlertMsg{ client->getAccount().m_AccUser }))) {
+				MessageClient(client->getAccount().m_AccUser, EncodeMessage(ChatResponseMsg{ receiver, 4 }));
 			}
 			else { //Possible party, push it into possible pool
-				m_PossibleParty.PushBack(party);
+				m_PossibleParty.push_back(party);
 			}
 		}
 	}
@@ -663,20 +913,20 @@ public:
 
 	void AcceptConnection(std::shared_ptr<Connection> client) {
 		client->ClientConnectionAction(true);
-		m_Directory[client->getAccount().m_AccUser] = client->getPermIndex();
-		Packet accept(PacketType::ServerAccept);
-		MessageClient(client->getAccount().m_AccUser, accept);
+		client->SetUserID(static_cast<UserID>(m_NextUserID++));
+		m_Directory[client->getAccount().m_AccUser] = client->getHandle();
+		MessageClient(client->getAccount().m_AccUser, EncodeMessage(ServerAcceptMsg{}));
+		PublishPresence(PresenceChange::Join, client);
+		SendPresenceSnapshot(client);
 		SendOnlineList();
 	}
 
 	void RejectConnection(std::shared_ptr<Connection> client, int rejectionCode) {
 		client->ClientConnectionAction(false);
-		Packet invalidInfo(PacketType::ServerReject, rejectionCode);
-		client->Send(invalidInfo);
+		client->Send(EncodeMessage(ServerRejectMsg{ rejectionCode }));
 
 		if (rejectionCode == 6) {
-			Packet kickPacket(PacketType::LeaveServer);
-			client->Send(kickPacket);
+			client->Send(EncodeMessage(LeaveServerMsg{}));
 			client->IgnoreConnection();
 			client.reset();
 		}
@@ -692,11 +942,57 @@ public:
 		return false;
 	}
 
-	void SendOnlineList() { //Send the client a list of users they can join
+	//Tells every client with FEATURE_PRESENCE what changed about the user, a joining user is left out as they get a
+	//snapshot instead. Each delta is encoded once for everyone, so a change costs one small packet per client rather
+	//than rebuilding the whole list for each of them
+	void PublishPresence(PresenceChange change, const std::shared_ptr<Connection>& user) {
+		if (change == PresenceChange::Status) { //Clients already dropped a user that left, a status would bring them back
+			auto entry = m_Directory.find(user->getAccount().m_AccUser);
+			if (entry == m_Directory.end() || entry->second != user->getHandle()) {
+				return;
+			}
+		}
+
+		std::string username; //Only filled in for a join, the record just points at it
+		PresenceDeltaMsg delta{ ++m_PresenceVersion, static_cast<uint8_t>(change), PresenceRecord{} };
+		delta.m_Record.m_ID = user->getUserID();
+
+		if (change != PresenceChange::Leave) {
+			delta.m_Record.m_Status = static_cast<uint8_t>(user->m_Status.load());
+		}
+
+		if (change == PresenceChange::Join) {
+			username = user->getAccount().m_AccUser;
+			delta.m_Record.m_User = username;
+		}
+
+		MessageAll(EncodeMessage(delta), (change == PresenceChange::Join) ? user : nullptr, FEATURE_PRESENCE);
+	}
+
+	//For clients with FEATURE_PRESENCE that just logged in or asked for a resync, the deltas carry on from its version
+	void SendPresenceSnapshot(const std::shared_ptr<Connection>& client) {
+		if (!(client->getFeatures() & FEATURE_PRESENCE)) {
+			return;
+		}
+
+		PresenceSnapshotMsg snapshot{ m_PresenceVersion, {} };
+		snapshot.m_Users.reserve(m_Directory.size());
+
+		for (const auto& entry : m_Directory) { //The records point at the directory's usernames
+			std::shared_ptr<Connection>* user = m_Connections.Get(entry.second);
+
+			if (user) {
+				snapshot.m_Users.push_back({ (*user)->getUserID(), static_cast<uint8_t>((*user)->m_Status.load()), entry.first });
+			}
+		}
+
+		client->Send(EncodeMessage(snapshot));
+	}
+
+	void SendOnlineList() { //Send the client a list of users they can join, only clients without FEATURE_PRESENCE need it
 		if (m_Directory.size() > 1) {
 			for (auto& client : m_Connections) {
-				if (client->getID() != 0) {
-					Packet onlineList(PacketType::OnlineList);
+				if (client->getID() != 0 && !(client->getFeatures() & FEATURE_PRESENCE)) {
 					std::string str = "";
 
 					for (auto& printClient : m_Connections) {
@@ -705,43 +1001,17 @@ public:
 						}
 					}
 
-					onlineList << str;
-					MessageClient(client->getAccount().m_AccUser, onlineList);
+					MessageClient(client->getAccount().m_AccUser, EncodeMessage(OnlineListMsg{ str }));
 				}
 			}
 		}
 		else {
-			Packet onlineList(PacketType::OnlineList);
-			std::string str = "You Are The Only One Online!\n";
-			onlineList << str;
+			std::shared_ptr<Connection> client = FindClient(m_Directory.begin()->first);
 
-			MessageClient(m_Directory.begin()->first, onlineList);
-		}
-	}
-
-	//Just needed to convert the enum to string for SendOnlineList()
-	std::string StatusTranslator(ChatStatus status) {
-		std::string str = "";
-
-		switch (status) {
-			case ChatStatus::Server:
-				str = "Server";
-				break;
-			
-			case ChatStatus::Chatting:
-				str = "Chatting";
-				break;
-
-			case ChatStatus::Open: 
-				str = "Open";
-				break;
-
-			default:
-				str = "Unknown";
-				break;
+			if (!client || !(client->getFeatures() & FEATURE_PRESENCE)) {
+				MessageClient(m_Directory.begin()->first, EncodeMessage(OnlineListMsg{ "You Are The Only One Online!\n" }));
+			}
 		}
-
-		return str;
 	}
 
 	void OnClientDisconnect(std::string username) {
@@ -749,7 +1019,7 @@ public:
 		WriteToLog(username + " Has Disconnected");
 	}
 
-	bool OnClientConnect(std::shared_ptr<Connection> connection) {
+	bool OnClientConnect([[maybe_unused]] std::shared_ptr<Connection> connection) {
 		//Can handle whether or not to deal with connections based on ip or their inital information from here
 		return true;
 	}
@@ -802,21 +1072,33 @@ public:
 
 private:
 	asio::io_context m_Context;
-	std::thread m_ContextThread;
+	std::vector<std::thread> m_ContextThreads;
 	asio::ip::tcp::acceptor m_ASIOAcceptor;
+	DispatchMode m_DispatchMode;
+	size_t m_ThreadCount;
+	asio::strand<asio::io_context::executor_type> m_DispatchStrand = asio::make_strand(m_Context); //Runs OnMessage in DispatchMode::Strand
 	
 	std::string m_LogFilePath;
 
-	//Does not need to be the thread safe version as only a single thread (server thread) will handle this
-	std::deque<std::shared_ptr<Connection>> m_Connections;
+	//Connections, the directory, the ID counters and the possible chat parties are only touched while holding
+	//m_StateMutex: by HandlePacket(), the accept handler and Stop(). That holds in every mode, DispatchMode::Sharded
+	//included, where logins, chat requests and presence from all shards queue up on it. Uncontended in
+	//DispatchMode::Strand, where the dispatch strand already keeps packet handlers apart. Chat messages skip it, see
+	//ProcessMessage()
+	std::mutex m_StateMutex;
+	Slab<std::shared_ptr<Connection>> m_Connections; //Every connection still open or logged in, see ReapConnections()
 	//Need this to work so two clients can message eachother with consent
-	std::unordered_map<std::string, int> m_Directory; //Associate a username with a connection index
+	std::unordered_map<std::string, SlabHandle> m_Directory; //Associate a username with its connection's handle
 
-	TSQueue<OwnedPacket> m_IncomingPackets;
+	IncomingPacketQueue m_IncomingPackets;
+	std::deque<OwnedPacket> m_PendingPackets; //Taken from m_IncomingPackets but not handled yet, only used by Update()
+	ConnectionLimits m_Limits; //Handed to every accepted connection
 
 	unsigned int m_IDCounter = 1000;
-	int m_UserIndex = -1; //To be used in m_Directory, and keep track of connection array index
+	uint32_t m_NextUserID = 1; //0 is UserID::None
+	uint32_t m_PresenceVersion = 0; //Goes up with every PresenceDeltaMsg
+
+	std::vector<ChatParty> m_PossibleParty; //Requests waiting on an answer, only touched under m_StateMutex
 
-	TSQueue<ChatParty> m_PossibleParty;
-	TSQueue<ChatParty> m_OngoingConversations;
+	std::vector<std::unique_ptr<Shard>> m_Shards; //Only in DispatchMode::Sharded
 };
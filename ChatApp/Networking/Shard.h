@@ -0,0 +1,164 @@
+#pragma once
+#include "Packet.h"
+#include "MPSCQueue.h"
+#include "SPSCQueue.h"
+
+//One worker thread of DispatchMode::Sharded. Each shard handles the packets of the users hashed to it on its own
+//thread. The only state a shard owns outright is its users' partner handles, so chat messages are relayed on every
+//shard at once. The directory, the connections and pending chat requests are still shared and guarded by the server's
+//m_StateMutex. Packets come in through the inbox from whichever io thread read them. Work another shard hands over
+//comes through a mailbox kept just for that shard, so every mailbox has a single producer and a single consumer
+class Shard {
+public:
+	using Task = std::function<void()>;
+	using PacketHandler = std::function<void(OwnedPacket&)>;
+
+	Shard(size_t index, size_t shardCount, PacketHandler handler)
+		:m_Index(index), m_PacketHandler(std::move(handler))
+	{
+		for (size_t i = 0; i < shardCount; i++) {
+			m_Mailboxes.push_back(std::make_unique<SPSCQueue<Task>>(MAILBOX_CAPACITY));
+		}
+	}
+
+	Shard(const Shard&) = delete;
+
+	~Shard() {
+		Stop();
+	}
+
+	void Start() {
+		m_Stopping = false;
+		m_Thread = std::thread([this]() { Run(); });
+	}
+
+	//Handles whatever is already queued, then stops
+	void Stop() {
+		m_Stopping = true;
+		Wake();
+
+		if (m_Thread.joinable()) {
+			m_Thread.join();
+		}
+	}
+
+	void Post(OwnedPacket&& packet) { //Any thread
+		m_Inbox.Push(std::move(packet));
+		Wake();
+	}
+
+	//Only from the thread of the shard sending it, which may be holding the server's locks, so it never waits. If the
+	//mailbox is full, or earlier mail is already waiting, the task waits in the sender's outbox until it's between packets
+	void Mail(Shard& from, Task&& task) {
+		if (from.m_Outbox.empty() && m_Mailboxes[from.getIndex()]->TryPushBack(std::move(task))) {
+			Wake();
+			return;
+		}
+
+		from.m_Outbox.push_back({ this, std::move(task) });
+	}
+
+	inline size_t getIndex() const {
+		return m_Index;
+	}
+
+	//The shard whose thread is calling, nullptr off the shard threads
+	static Shard*& Current() {
+		thread_local Shard* current = nullptr;
+		return current;
+	}
+
+private:
+	void Run() {
+		Current() = this;
+		std::deque<OwnedPacket> packets;
+
+		while (true) {
+			m_WakePending.exchange(false); //Read modify write so everything pushed before the matching Wake() is seen below
+
+			//Packets are taken before the mail. Anything another shard mailed before one of these packets was read
+			//is already in its mailbox then, so it's applied first
+			OwnedPacket packet;
+			while (m_Inbox.Pop(packet)) {
+				packets.push_back(std::move(packet));
+			}
+
+			bool busy = RunMail() | !packets.empty();
+
+			SendOutbox();
+
+			for (OwnedPacket& queued : packets) {
+				m_PacketHandler(queued);
+				SendOutbox();
+			}
+			packets.clear();
+
+			if (!busy) {
+				if (m_Stopping) {
+					break;
+				}
+
+				std::unique_lock<std::mutex> lock(m_WakeMutex);
+				m_WakeCV.wait(lock, [this]() { return m_WakePending.load() || m_Stopping.load(); });
+			}
+		}
+
+		Current() = nullptr;
+	}
+
+	bool RunMail() {
+		bool ranAny = false;
+		Task task;
+
+		for (auto& mailbox : m_Mailboxes) {
+			while (mailbox->TryPopFront(task)) {
+				task();
+				ranAny = true;
+			}
+		}
+
+		return ranAny;
+	}
+
+	//Only between packets, when nothing is locked. While a mailbox is full this shard works through its own, so two
+	//shards mailing each other never wait on one another forever
+	void SendOutbox() {
+		for (size_t i = 0; i < m_Outbox.size(); i++) { //Mail run below can add to the outbox
+			Shard* to = m_Outbox[i].first;
+			Task task = std::move(m_Outbox[i].second);
+
+			SPSCQueue<Task>& mailbox = *to->m_Mailboxes[m_Index];
+			while (!mailbox.TryPushBack(std::move(task))) {
+				RunMail();
+				std::this_thread::yield();
+			}
+
+			to->Wake();
+		}
+
+		m_Outbox.clear();
+	}
+
+	//Only the first push since the shard last looked pays for the mutex
+	void Wake() {
+		if (!m_WakePending.exchange(true)) {
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_WakeCV.notify_one();
+		}
+	}
+
+	static constexpr size_t MAILBOX_CAPACITY = 1024;
+
+	size_t m_Index;
+	PacketHandler m_PacketHandler;
+	std::thread m_Thread;
+	std::atomic<bool> m_Stopping{ false };
+
+	MPSCQueue<OwnedPacket> m_Inbox;
+	std::vector<std::unique_ptr<SPSCQueue<Task>>> m_Mailboxes; //Indexed by the sending shard
+	std::vector<std::pair<Shard*, Task>> m_Outbox; //Mail this shard couldn't hand over yet, in the order it was sent
+
+	std::atomic<bool> m_WakePending{ false };
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCV;
+};
\ No newline at end of file
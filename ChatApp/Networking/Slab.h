@@ -0,0 +1,152 @@
+#pragma once
+#include "NetIncludes.h"
+
+//Handle to an item in a Slab. The low SLAB_INDEX_BITS pick the slot and the rest hold the slot's generation when the
+//item went in. A slot's generation moves on each time it's freed, so a handle to an erased item never finds whatever
+//took its slot afterwards. 0 is never handed out
+using SlabHandle = uint32_t;
+
+constexpr SlabHandle INVALID_SLAB_HANDLE = 0;
+constexpr uint32_t SLAB_INDEX_BITS = 20; //About a million items at once, 4096 reuses of a slot before a handle repeats
+constexpr uint32_t SLAB_INDEX_MASK = (1u << SLAB_INDEX_BITS) - 1;
+constexpr uint32_t SLAB_GENERATION_COUNT = 1u << (32 - SLAB_INDEX_BITS);
+
+//Table handing out a handle per item, with erased slots going on a free list to be reused. The items themselves are
+//kept packed together, an erase moves the last one into the gap, so walking the table only touches live items and
+//its size follows what's in it rather than everything ever inserted. Not thread safe
+template<typename T>
+class Slab {
+public:
+	//INVALID_SLAB_HANDLE when every slot is taken
+	SlabHandle Insert(T&& item) {
+		uint32_t slot;
+
+		if (m_FreeHead != NO_SLOT) {
+			slot = m_FreeHead;
+			m_FreeHead = m_Slots[slot].m_Position;
+		}
+		else {
+			if (m_Slots.size() > SLAB_INDEX_MASK) {
+				return INVALID_SLAB_HANDLE;
+			}
+
+			slot = static_cast<uint32_t>(m_Slots.size());
+			m_Slots.push_back({ 1, 0 });
+		}
+
+		m_Slots[slot].m_Position = static_cast<uint32_t>(m_Items.size());
+		m_Items.push_back(std::move(item));
+		m_ItemSlots.push_back(slot);
+		return MakeHandle(slot);
+	}
+
+	bool Erase(SlabHandle handle) {
+		if (!Contains(handle)) {
+			return false;
+		}
+
+		uint32_t slot = handle & SLAB_INDEX_MASK;
+		uint32_t position = m_Slots[slot].m_Position;
+
+		if (position != m_Items.size() - 1) {
+			m_Items[position] = std::move(m_Items.back());
+			m_ItemSlots[position] = m_ItemSlots.back();
+			m_Slots[m_ItemSlots[position]].m_Position = position;
+		}
+
+		m_Items.pop_back();
+		m_ItemSlots.pop_back();
+
+		Slot& freed = m_Slots[slot];
+		freed.m_Generation = (freed.m_Generation + 1) % SLAB_GENERATION_COUNT;
+		if (freed.m_Generation == 0) { //Keeps 0 free for INVALID_SLAB_HANDLE
+			freed.m_Generation = 1;
+		}
+
+		freed.m_Position = m_FreeHead;
+		m_FreeHead = slot;
+		return true;
+	}
+
+	//Erases every item the predicate returns true for, returns how many went
+	template<typename Predicate>
+	size_t EraseIf(Predicate predicate) {
+		size_t erased = 0;
+
+		//Back to front, an erase only ever moves an item that's already been looked at
+		for (size_t i = m_Items.size(); i-- > 0; ) {
+			if (predicate(m_Items[i])) {
+				Erase(HandleAt(i));
+				erased++;
+			}
+		}
+
+		return erased;
+	}
+
+	//nullptr if the handle's item has been erased
+	T* Get(SlabHandle handle) {
+		return (Contains(handle)) ? &m_Items[m_Slots[handle & SLAB_INDEX_MASK].m_Position] : nullptr;
+	}
+
+	const T* Get(SlabHandle handle) const {
+		return (Contains(handle)) ? &m_Items[m_Slots[handle & SLAB_INDEX_MASK].m_Position] : nullptr;
+	}
+
+	bool Contains(SlabHandle handle) const {
+		uint32_t slot = handle & SLAB_INDEX_MASK;
+		return slot < m_Slots.size() && m_Slots[slot].m_Generation == (handle >> SLAB_INDEX_BITS) && IsLive(slot);
+	}
+
+	//Handle of the item at a position while walking the table
+	SlabHandle HandleAt(size_t position) const {
+		return MakeHandle(m_ItemSlots[position]);
+	}
+
+	//Only the live items, in no particular order
+	typename std::vector<T>::iterator begin() {
+		return m_Items.begin();
+	}
+
+	typename std::vector<T>::iterator end() {
+		return m_Items.end();
+	}
+
+	typename std::vector<T>::const_iterator begin() const {
+		return m_Items.begin();
+	}
+
+	typename std::vector<T>::const_iterator end() const {
+		return m_Items.end();
+	}
+
+	size_t count() const {
+		return m_Items.size();
+	}
+
+	bool isEmpty() const {
+		return m_Items.empty();
+	}
+
+private:
+	struct Slot {
+		uint32_t m_Generation;
+		uint32_t m_Position; //Where the item is in m_Items, or the next free slot while this one is free
+	};
+
+	SlabHandle MakeHandle(uint32_t slot) const {
+		return (m_Slots[slot].m_Generation << SLAB_INDEX_BITS) | slot;
+	}
+
+	bool IsLive(uint32_t slot) const {
+		uint32_t position = m_Slots[slot].m_Position;
+		return position < m_ItemSlots.size() && m_ItemSlots[position] == slot;
+	}
+
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	std::vector<Slot> m_Slots;
+	std::vector<T> m_Items;
+	std::vector<uint32_t> m_ItemSlots; //Slot of each item in m_Items, for fixing up the one an erase moves
+	uint32_t m_FreeHead = NO_SLOT;
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
+#pragma once
 #include "NetIncludes.h"
 
-//Queue meant to be thread save, as networking works with threading
+//Queue meant to be thread save, as networking works with threading. Every call takes the lock for the whole
+//operation, so there's nothing that hands out a reference into the queue or a size that's stale once the lock is
+//released: consumers take items with TryPopFront() or PopAll() and sleep with Wait()
 template<typename T>
 class TSQueue {
 public:
@@ -16,88 +19,83 @@ public:
 	}
 	
 	void PushBack(const T& data) {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		m_DeQueue.emplace_back(std::move(data));
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_DeQueue.emplace_back(data);
+		}
 
-		std::unique_lock<std::mutex> ul(m_PushMutex);
-		m_WaitCV.notify_one();
+		m_WaitCV.notify_one(); //After unlocking so the woken thread doesn't block on the mutex straight away
 	}
 
-	void PushFront(const T& data) {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		m_DeQueue.emplace_front(std::move(data));
+	void PushBack(T&& data) { //Takes over the data instead of copying it
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_DeQueue.emplace_back(std::move(data));
+		}
 
-		std::unique_lock<std::mutex> ul(m_PushMutex);
 		m_WaitCV.notify_one();
 	}
 
-	//Method is meant to hold up a thread until new data is pushed in
-	void Wait() {
-		while (isEmpty()) { 
-			std::unique_lock<std::mutex> ul(m_PushMutex);
-			m_WaitCV.wait(ul);
+	void PushFront(const T& data) {
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_DeQueue.emplace_front(data);
 		}
-	}
 
-	T PopFront() {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		auto t = std::move(m_DeQueue.front()); //Save the item to return it
-		m_DeQueue.pop_front();
-		return t;
-	}
-
-	T PopBack() {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		auto t = std::move(m_DeQueue.back());
-		m_DeQueue.pop_back();
-		return t;
-	}
-
-	T Erase(size_t index) {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		auto t = std::move(m_DeQueue[index]);
-		m_DeQueue.erase(m_DeQueue.begin() + index);
-		return t;
+		m_WaitCV.notify_one();
 	}
 
-	const T& Front() {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		return m_DeQueue.front();
-	}
+	void PushFront(T&& data) {
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			m_DeQueue.emplace_front(std::move(data));
+		}
 
-	const T& Back() {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		return m_DeQueue.back();
+		m_WaitCV.notify_one();
 	}
 
-	const T& At(unsigned int index) {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		return m_DeQueue[index];
+	//Method is meant to hold up a thread until new data is pushed in. The check and the wait happen under the same lock
+	//a push takes, so a push can't slip in between them and go unnoticed
+	void Wait() {
+		std::unique_lock<std::mutex> lock(m_QueueMutex);
+		m_WaitCV.wait(lock, [this]() { return !m_DeQueue.empty(); });
 	}
 
-	bool isEmpty() {
-		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		return m_DeQueue.empty();
+	//Same as Wait() but gives up after the timeout, returns false if the queue is still empty
+	template<typename Rep, typename Period>
+	bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> lock(m_QueueMutex);
+		return m_WaitCV.wait_for(lock, timeout, [this]() { return !m_DeQueue.empty(); });
 	}
 
-	size_t count() {
+	//Takes every queued item in one lock. out should be empty, it's swapped with the queue so its memory gets reused
+	//by the producers instead of being freed
+	void PopAll(std::deque<T>& out) {
 		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		return m_DeQueue.size();
+		if (out.empty()) {
+			out.swap(m_DeQueue);
+		}
+		else {
+			std::move(m_DeQueue.begin(), m_DeQueue.end(), std::back_inserter(out));
+			m_DeQueue.clear();
+		}
 	}
 
-	const T& operator[](size_t index) {
+	//Checks for and takes the front item in a single lock, returns false if there was nothing to take
+	bool TryPopFront(T& out) {
 		std::lock_guard<std::mutex> lock(m_QueueMutex);
-		if (index >= m_DeQueue.size()) {
-			throw std::exception();
+		if (m_DeQueue.empty()) {
+			return false;
 		}
 
-		return m_DeQueue[index];
+		out = std::move(m_DeQueue.front());
+		m_DeQueue.pop_front();
+		return true;
 	}
 
 private:
 	std::mutex m_QueueMutex;
-	std::mutex m_PushMutex;
-	std::condition_variable m_WaitCV;
+	std::condition_variable m_WaitCV; //Signaled on every push, waits on m_QueueMutex
 
 	std::deque<T> m_DeQueue;
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+#include "NetIncludes.h"
+
+//Helpers for putting numbers on the wire in a fixed little endian layout. Values are built byte by byte so the
+//result is the same no matter the compiler, cpu or struct padding, and reading them back never relies on casts
+inline void StoreLE(uint8_t* out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		out[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+template<typename Buffer>
+void WriteLE(Buffer& out, uint64_t value, size_t bytes) {
+	uint8_t encoded[8];
+	StoreLE(encoded, value, bytes);
+	out.append(encoded, bytes);
+}
+
+inline uint64_t ReadLE(const uint8_t* data, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; i++) {
+		value |= static_cast<uint64_t>(data[i]) << (i * 8);
+	}
+
+	return value;
+}
+
+//7 bits per byte, high bit set while more bytes follow. Anything under 128 takes a single byte
+constexpr size_t MAX_VARINT_BYTES = 10;
+
+inline size_t EncodeVarint(uint64_t value, uint8_t* out) {
+	size_t length = 0;
+	while (value >= 0x80) {
+		out[length++] = static_cast<uint8_t>(value) | 0x80;
+		value >>= 7;
+	}
+
+	out[length++] = static_cast<uint8_t>(value);
+	return length;
+}
+
+template<typename Buffer>
+void WriteVarint(Buffer& out, uint64_t value) {
+	uint8_t encoded[MAX_VARINT_BYTES];
+	out.append(encoded, EncodeVarint(value, encoded));
+}
+
+//Returns false if the data ends before the varint does or the varint is longer than any 64 bit value can be
+inline bool ReadVarint(const uint8_t* data, size_t size, size_t& offset, uint64_t& value) {
+	value = 0;
+
+	for (size_t i = 0; i < MAX_VARINT_BYTES && offset < size; i++) {
+		uint8_t byte = data[offset++];
+		value |= static_cast<uint64_t>(byte & 0x7F) << (i * 7);
+
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include "Packet.h"
+#include "WireFormat.h"
+
+//How a PacketHeader is laid out on the wire, picked per connection from the features agreed on during validation.
+//Legacy: 4 byte type + 4 byte size, little endian. What the first clients sent by copying the struct.
+//Compact: 1 byte type + varint size, 2 bytes for any body under 128 bytes
+enum class HeaderFormat : uint8_t {
+	Legacy, Compact
+};
+
+constexpr size_t LEGACY_HEADER_SIZE = 8;
+constexpr size_t MAX_HEADER_SIZE = LEGACY_HEADER_SIZE; //Compact is at most 1 + 5 bytes for a 32 bit size
+
+//Flags share the type field with the PacketType, every type fits under the lowest flag bit
+constexpr uint8_t HEADER_FLAG_COMPRESSED = 0x80; //Body is LZ compressed, see Compression.h
+constexpr uint8_t HEADER_FLAG_MASK = HEADER_FLAG_COMPRESSED;
+
+enum class HeaderResult {
+	Complete, Incomplete, Invalid
+};
+
+//Writes the header to out (at least MAX_HEADER_SIZE bytes) and returns how many bytes it took
+inline size_t EncodeHeader(HeaderFormat format, const PacketHeader& header, uint8_t* out) {
+	uint32_t type = static_cast<uint32_t>(header.m_ID) | header.m_Flags;
+
+	if (format == HeaderFormat::Compact) {
+		out[0] = static_cast<uint8_t>(type);
+		return 1 + EncodeVarint(header.m_Size, out + 1);
+	}
+
+	StoreLE(out, type, 4);
+	StoreLE(out + 4, header.m_Size, 4);
+	return LEGACY_HEADER_SIZE;
+}
+
+//Incomplete means the header was split and more bytes are needed, Invalid means the stream can't be trusted anymore
+inline HeaderResult DecodeHeader(HeaderFormat format, const uint8_t* data, size_t size, PacketHeader& header, size_t& headerLength) {
+	if (format == HeaderFormat::Compact) {
+		if (size < 2) {
+			return HeaderResult::Incomplete;
+		}
+
+		size_t offset = 1;
+		uint64_t bodySize;
+		if (!ReadVarint(data, size, offset, bodySize)) {
+			//Ran out of bytes mid varint, unless it's already longer than any 32 bit size can be
+			return (size - 1 >= 5) ? HeaderResult::Invalid : HeaderResult::Incomplete;
+		}
+
+		if (bodySize > UINT32_MAX) {
+			return HeaderResult::Invalid;
+		}
+
+		header.m_ID = static_cast<PacketType>(data[0] & ~HEADER_FLAG_MASK);
+		header.m_Flags = data[0] & HEADER_FLAG_MASK;
+		header.m_Size = static_cast<uint32_t>(bodySize);
+		headerLength = offset;
+		return HeaderResult::Complete;
+	}
+
+	if (size < LEGACY_HEADER_SIZE) {
+		return HeaderResult::Incomplete;
+	}
+
+	uint32_t type = static_cast<uint32_t>(ReadLE(data, 4));
+	header.m_ID = static_cast<PacketType>(static_cast<int32_t>(type & ~static_cast<uint32_t>(HEADER_FLAG_MASK)));
+	header.m_Flags = static_cast<uint8_t>(type & HEADER_FLAG_MASK);
+	header.m_Size = static_cast<uint32_t>(ReadLE(data + 4, 4));
+	headerLength = LEGACY_HEADER_SIZE;
+	return HeaderResult::Complete;
+}
\ No newline at end of file
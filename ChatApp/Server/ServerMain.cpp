@@ -8,7 +8,8 @@ bool g_Running = true;
 int main() {
 	SetConsoleCtrlHandler((PHANDLER_ROUTINE)ConsoleHandle, TRUE);
 
-	g_Server = new Server(3000);
+	//A thread per core for the sockets, the packets they read are handled here through Update()
+	g_Server = new Server(3000, DispatchMode::Queue, std::thread::hardware_concurrency());
 	g_Server->Start();
 
 	while(g_Running) {
@@ -0,0 +1,65 @@
+#include "NetTest.h"
+
+static uint64_t Acquisitions() {
+	BufferPoolStats stats = BufferPool::Get().getStats();
+	return stats.m_Hits + stats.m_Misses + stats.m_Oversized;
+}
+
+//A message too big for the inline body should cost one pooled buffer each time its bytes are written: the sender's
+//encode, the server's read and the receiver's read. The server forwards the buffer it read into, so anything more
+//is a copy on the hot path
+TEST(RelayedMessageBufferCount) {
+	constexpr size_t MESSAGES = 64;
+	const std::string text(300, 'x'); //Past the 128 inline bytes but under the compression threshold
+
+	ChatPair pair;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100)); //Let the presence updates from the chat starting go out
+
+	uint64_t before = Acquisitions();
+	for (size_t i = 0; i < MESSAGES; i++) { //One at a time so nothing gets batched
+		pair.m_First.Send(EncodeMessage(UserChatMsg{ pair.m_SecondID, text }));
+
+		UserChatMsg message;
+		Packet packet = WaitForPacket(pair.m_Second, PacketType::UserMessage);
+		CHECK(DecodeMessage(packet, message));
+		CHECK(message.m_Text == text);
+	}
+	uint64_t used = Acquisitions() - before;
+
+	std::cout << "\t" << used << " buffers for " << MESSAGES << " relayed messages" << std::endl;
+	CHECK(used <= MESSAGES * 3);
+}
+
+//Small messages stay in the inline body from end to end
+TEST(SmallMessageUsesNoBuffers) {
+	ChatPair pair;
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	uint64_t before = Acquisitions();
+	for (int i = 0; i < 16; i++) {
+		pair.m_First.Send(EncodeMessage(UserChatMsg{ pair.m_SecondID, "hello there" }));
+		WaitForPacket(pair.m_Second, PacketType::UserMessage);
+	}
+
+	CHECK(Acquisitions() == before);
+}
+
+//Forwarding rewrites the sender in place, whether the new one takes more bytes, fewer or the same
+TEST(ReplaceFirstFieldKeepsTheRest) {
+	const std::string text(300, 'y');
+
+	Packet packet = EncodeMessage(ChatMsg{ "al", text });
+	for (std::string_view sender : { "alexandria", "a", "bo" }) {
+		ChatMsg message;
+		CHECK(ReplaceFirstField(packet, sender));
+		CHECK(DecodeMessage(packet, message) && message.m_Sender == sender && message.m_Text == text);
+		CHECK(packet.m_Header.m_Size == packet.m_Body.size());
+	}
+
+	packet = EncodeMessage(UserChatMsg{ UserID{ 5 }, text });
+	for (UserID user : { UserID{ 300 }, UserID{ 70000 }, UserID{ 1 } }) {
+		UserChatMsg message;
+		CHECK(ReplaceFirstField(packet, user));
+		CHECK(DecodeMessage(packet, message) && message.m_User == user && message.m_Text == text);
+	}
+}
\ No newline at end of file
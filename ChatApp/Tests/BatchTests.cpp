@@ -0,0 +1,50 @@
+#include "Test.h"
+#include "../Networking/Messages.h"
+#include "../Networking/Batch.h"
+
+static size_t Unpacked(const PacketBody& batch, bool& valid) {
+	size_t count = 0;
+	valid = UnpackBatch(batch, [&count](Packet&&) { count++; });
+	return count;
+}
+
+TEST(BatchRoundTrip) {
+	PacketBody batch;
+	AppendToBatch(batch, EncodeMessage(ChatRequestMsg{ "bob" }));
+	AppendToBatch(batch, EncodeMessage(ClientExitMsg{}));
+
+	bool valid = false;
+	CHECK(Unpacked(batch, valid) == 2 && valid);
+}
+
+//A peer can't smuggle in the packet only the connection itself makes by putting it in a batch
+TEST(BatchRejectsBackpressure) {
+	PacketBody batch;
+	AppendToBatch(batch, EncodeMessage(ChatRequestMsg{ "bob" }));
+	AppendToBatch(batch, EncodeMessage(BackpressureMsg{ true, 1 }));
+
+	bool valid = true;
+	CHECK(Unpacked(batch, valid) == 0 && !valid);
+}
+
+//Every sender keeps to these, a batch past any of them is a peer trying to get around the in flight cap
+TEST(BatchRejectsWhatNoSenderBuilds) {
+	bool valid = true;
+	PacketBody oversizedEntry;
+	AppendToBatch(oversizedEntry, EncodeMessage(ChatMsg{ "alice", std::string(MAX_BATCH_ENTRY_SIZE, 'x') }));
+	CHECK(Unpacked(oversizedEntry, valid) == 0 && !valid);
+
+	PacketBody tooMany, full;
+	for (size_t i = 0; i < MAX_BATCH_ENTRIES; i++) {
+		AppendToBatch(full, EncodeMessage(ClientExitMsg{}));
+	}
+
+	tooMany = full;
+	AppendToBatch(tooMany, EncodeMessage(ClientExitMsg{}));
+	CHECK(Unpacked(full, valid) == MAX_BATCH_ENTRIES && valid);
+	CHECK(Unpacked(tooMany, valid) == 0 && !valid);
+
+	PacketBody tooLarge;
+	tooLarge.resize(MAX_BATCH_SIZE + 1);
+	CHECK(Unpacked(tooLarge, valid) == 0 && !valid);
+}
\ No newline at end of file
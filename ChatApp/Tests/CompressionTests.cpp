@@ -0,0 +1,87 @@
+#include "Test.h"
+#include "../Networking/Compression.h"
+
+static std::vector<uint8_t> Bytes(const std::string& text) {
+	return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static bool RoundTrips(const std::vector<uint8_t>& data) {
+	PacketBody compressed, decompressed;
+	LZCompress(data.data(), data.size(), compressed);
+
+	return LZDecompress(compressed.data(), compressed.size(), decompressed) && decompressed.size() == data.size() &&
+		std::equal(data.begin(), data.end(), decompressed.data());
+}
+
+static bool Decompresses(const std::vector<uint8_t>& compressed, size_t maxSize = MAX_DECOMPRESSED_SIZE) {
+	PacketBody out;
+	return LZDecompress(compressed.data(), compressed.size(), out, maxSize);
+}
+
+TEST(CompressionRoundTrips) {
+	CHECK(RoundTrips({}));
+	CHECK(RoundTrips(Bytes("abc")));
+
+	//Nothing repeats, so it all goes out as literals with the extra literal count bytes
+	std::vector<uint8_t> noise(5000);
+	uint32_t state = 12345;
+	for (uint8_t& byte : noise) {
+		state = state * 1103515245 + 12345;
+		byte = static_cast<uint8_t>(state >> 16);
+	}
+	CHECK(RoundTrips(noise));
+
+	//Matches long enough to need several extra length bytes
+	CHECK(RoundTrips(std::vector<uint8_t>(100000, 'a')));
+
+	std::string list;
+	for (int i = 0; i < 200; i++) {
+		list += "user" + std::to_string(i) + " | Open\n";
+	}
+	CHECK(RoundTrips(Bytes(list)));
+}
+
+//An offset shorter than the match copies bytes the match itself just wrote
+TEST(CompressionOverlappingMatch) {
+	std::vector<uint8_t> compressed = { 9, 0x22, 'a', 'b', 1, 0, 0x10, 'c' }; //"ab", then 6 more from 1 back, then "c"
+	PacketBody out;
+	CHECK(LZDecompress(compressed.data(), compressed.size(), out));
+	CHECK(std::string(out.data(), out.data() + out.size()) == "abbbbbbbc");
+
+	std::vector<uint8_t> pattern;
+	for (int i = 0; i < 1000; i++) {
+		pattern.push_back("xyz"[i % 3]);
+	}
+	CHECK(RoundTrips(pattern));
+}
+
+TEST(CompressionRejectsBadInput) {
+	CHECK(!Decompresses({}));
+	CHECK(!Decompresses({ 0x80 })); //Size varint never ends
+
+	//A literal count promising more bytes than there are, and one that needs extra length bytes that never come
+	CHECK(!Decompresses({ 4, 0x40, 'a', 'b' }));
+	CHECK(!Decompresses({ 20, 0xF0 }));
+
+	//Token says a match follows but the offset is cut off
+	CHECK(!Decompresses({ 8, 0x10, 'a', 1 }));
+
+	//Back references before the start of the output, or to nowhere
+	CHECK(!Decompresses({ 6, 0x10, 'a', 2, 0 }));
+	CHECK(!Decompresses({ 5, 0x10, 'a', 0, 0 }));
+
+	//Output that would run past the size it said it had
+	CHECK(!Decompresses({ 2, 0x30, 'a', 'b', 'c' }));
+	CHECK(!Decompresses({ 3, 0x10, 'a', 1, 0 }));
+
+	//Output shorter than it said it would be
+	CHECK(!Decompresses({ 4, 0x20, 'a', 'b' }));
+
+	//Sizes over the limit are turned away before anything is allocated
+	PacketBody compressed;
+	std::vector<uint8_t> large(1000, 'a');
+	LZCompress(large.data(), large.size(), compressed);
+	std::vector<uint8_t> data(compressed.data(), compressed.data() + compressed.size());
+	CHECK(Decompresses(data, large.size()));
+	CHECK(!Decompresses(data, large.size() - 1));
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "NetTest.h"
+
+//The standard CRC32C check value, every path has to agree on it
+static const std::string CHECK_INPUT = "123456789";
+constexpr uint32_t CHECK_VALUE = 0xE3069283;
+
+static uint32_t TableCrc(const std::string& data, uint32_t crc = 0) {
+	return ~Crc32cTable(~crc, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+TEST(Crc32cCheckValue) {
+	CHECK(Crc32c(reinterpret_cast<const uint8_t*>(CHECK_INPUT.data()), CHECK_INPUT.size()) == CHECK_VALUE);
+	CHECK(TableCrc(CHECK_INPUT) == CHECK_VALUE);
+	CHECK(TableCrc("") == 0);
+
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+	if (HasHardwareCrc32c()) {
+		CHECK(~Crc32cHardware(~0u, reinterpret_cast<const uint8_t*>(CHECK_INPUT.data()), CHECK_INPUT.size()) == CHECK_VALUE);
+	}
+#endif
+}
+
+//Lengths either side of the 8 byte steps the hardware paths take, and a checksum continued over a second piece
+TEST(Crc32cPathsAgree) {
+	std::string data;
+	for (size_t i = 0; i < 300; i++) {
+		data.push_back(static_cast<char>(i * 31 + 7));
+	}
+
+	for (size_t length = 0; length <= data.size(); length++) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+		uint32_t expected = TableCrc(data.substr(0, length));
+		CHECK(Crc32c(bytes, length) == expected);
+
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+		if (HasHardwareCrc32c()) {
+			CHECK(~Crc32cHardware(~0u, bytes, length) == expected);
+		}
+#endif
+
+		size_t split = length / 3;
+		CHECK(Crc32c(bytes + split, length - split, Crc32c(bytes, split)) == expected);
+	}
+}
+
+//Offers only the compact header and checksums, then sends a frame whose trailer doesn't match
+class ChecksumPeer {
+public:
+	ChecksumPeer(const std::string& username, const std::string& password) : m_Socket(m_Context) {
+		m_Account.SetInfo(username, password, 2);
+	}
+
+	void Connect(uint16_t port) {
+		m_Socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+
+		uint64_t handshake = 0;
+		CHECK(!Read(&handshake, sizeof(handshake)) && (handshake & HANDSHAKE_HELLO));
+
+		//Connection::Rearrange() comes out the same whatever it's given, the flipped bit says a hello follows
+		uint64_t answer = ((0x982F21Cull | 0x14A6D2ull >> 2) | (0xF027BAC671FCull << 16)) ^ HANDSHAKE_HELLO;
+		std::array<uint8_t, HELLO_SIZE> hello;
+		EncodeHello({ PROTOCOL_VERSION, FEATURE_COMPACT_HEADER | FEATURE_CRC32C }, hello.data());
+		asio::write(m_Socket, std::array<asio::const_buffer, 2>{ asio::buffer(&answer, sizeof(answer)), asio::buffer(hello) });
+
+		CHECK(!Read(hello.data(), hello.size()));
+		CHECK(DecodeHello(hello.data()).m_Features == (FEATURE_COMPACT_HEADER | FEATURE_CRC32C));
+		asio::write(m_Socket, asio::buffer(&m_Account, sizeof(Account)));
+	}
+
+	void SendFrame(const Packet& packet, uint32_t corruption) {
+		std::vector<uint8_t> frame(MAX_HEADER_SIZE);
+		frame.resize(EncodeHeader(HeaderFormat::Compact, packet.m_Header, frame.data()));
+		frame.insert(frame.end(), packet.m_Body.data(), packet.m_Body.data() + packet.m_Body.size());
+
+		uint8_t trailer[CRC_TRAILER_SIZE];
+		StoreLE(trailer, Crc32c(frame.data(), frame.size()) ^ corruption, CRC_TRAILER_SIZE);
+		frame.insert(frame.end(), trailer, trailer + CRC_TRAILER_SIZE);
+		asio::write(m_Socket, asio::buffer(frame));
+	}
+
+	//Throws away whatever the server sends until it hangs up, false if it's still there after the timeout
+	bool WaitForClose() {
+		std::array<uint8_t, 256> discard;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+
+		while (std::chrono::steady_clock::now() < deadline) {
+			std::error_code ec = Read(discard.data(), 1);
+			if (ec == asio::error::eof || ec == asio::error::connection_reset) {
+				return true;
+			}
+			else if (ec) {
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	void Close() {
+		std::error_code ec;
+		m_Socket.close(ec);
+	}
+
+private:
+	std::error_code Read(void* data, size_t size) {
+		std::error_code result = asio::error::timed_out;
+		asio::async_read(m_Socket, asio::buffer(data, size), [&result](std::error_code ec, size_t) {
+			result = ec;
+		});
+
+		m_Context.restart();
+		m_Context.run_for(std::chrono::seconds(3));
+		return result;
+	}
+
+	asio::io_context m_Context;
+	asio::ip::tcp::socket m_Socket;
+	Account m_Account; //The server copies this object's bytes as they are, so it has to outlive the connection
+};
+
+TEST(CorruptedTrailerClosesConnection) {
+	ResetServerFiles();
+	Server server(TEST_PORT, DispatchMode::Strand);
+	CHECK(server.Start());
+
+	ChecksumPeer peer("alice", "pw");
+	peer.Connect(TEST_PORT);
+
+	uint64_t failures = ChecksumFailures();
+	peer.SendFrame(EncodeMessage(ChatRequestMsg{ "bob" }), 1);
+	CHECK(peer.WaitForClose());
+	CHECK(ChecksumFailures() == failures + 1);
+
+	peer.Close();
+	server.Stop();
+}
\ No newline at end of file
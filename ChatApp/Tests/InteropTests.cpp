@@ -0,0 +1,121 @@
+#include "NetTest.h"
+
+//Talks to the server the way the version 1 client did, byte for byte: the handshake answer, the raw Account struct,
+//then 8 byte headers copied from memory and raw string bodies
+class LegacyPeer {
+public:
+	LegacyPeer(const std::string& username, const std::string& password) : m_Socket(m_Context) {
+		m_Account.SetInfo(username, password, 2);
+	}
+
+	void Connect(uint16_t port) {
+		m_Socket.connect(asio::ip::tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+
+		uint64_t handshake = 0;
+		Read(&handshake, sizeof(handshake));
+
+		//The old client's Rearrange() ignored the number it was given and always answered with this
+		uint64_t answer = (0x982F21Cull | 0x14A6D2ull >> 2) | (0xF027BAC671FCull << 16);
+		asio::write(m_Socket, asio::buffer(&answer, sizeof(answer)));
+		asio::write(m_Socket, asio::buffer(&m_Account, sizeof(Account)));
+	}
+
+	void Send(PacketType type, std::string_view body) {
+		int32_t id = static_cast<int32_t>(type);
+		uint32_t size = static_cast<uint32_t>(body.size());
+
+		std::string frame(8, '\0');
+		std::memcpy(&frame[0], &id, 4);
+		std::memcpy(&frame[4], &size, 4);
+		frame.append(body);
+		asio::write(m_Socket, asio::buffer(frame));
+	}
+
+	//Body of the next packet of the given type, skipping anything else
+	std::string WaitFor(PacketType type) {
+		while (true) {
+			int32_t id = 0;
+			uint32_t size = 0;
+			Read(&id, 4);
+			Read(&size, 4);
+
+			std::string body(size, '\0');
+			Read(&body[0], size);
+
+			if (static_cast<PacketType>(id) == type) {
+				return body;
+			}
+		}
+	}
+
+	void Close() {
+		std::error_code ec;
+		m_Socket.close(ec);
+	}
+
+private:
+	void Read(void* data, size_t size) {
+		if (size == 0) {
+			return;
+		}
+
+		bool done = false;
+		asio::async_read(m_Socket, asio::buffer(data, size), [&done](std::error_code ec, size_t) {
+			done = !ec;
+		});
+
+		m_Context.restart();
+		m_Context.run_for(std::chrono::seconds(3));
+		if (!done) {
+			throw TestFailure{ "Legacy peer timed out or lost the connection while reading" };
+		}
+	}
+
+	asio::io_context m_Context;
+	asio::ip::tcp::socket m_Socket;
+	Account m_Account; //The server copies this object's bytes as they are, so it has to outlive the connection
+};
+
+//A version 1 client has a whole conversation with a current one through the server
+TEST(BaselineClientBytesInterop) {
+	ResetServerFiles();
+	Server server(TEST_PORT, DispatchMode::Strand);
+	CHECK(server.Start());
+
+	LegacyPeer alice("alice", "pw");
+	alice.Connect(TEST_PORT);
+	alice.WaitFor(PacketType::ServerAccept);
+
+	Client bob;
+	bob.Connect("127.0.0.1", TEST_PORT, "bob", "pw", 2);
+	WaitForPacket(bob, PacketType::ServerAccept);
+
+	alice.Send(PacketType::ChatRequest, "bob");
+	UserInfoMsg aliceInfo;
+	Packet infoPacket = WaitForPacket(bob, PacketType::UserInfo);
+	CHECK(DecodeMessage(infoPacket, aliceInfo) && aliceInfo.m_User == "alice");
+
+	ChatAlertMsg alert;
+	Packet alertPacket = WaitForPacket(bob, PacketType::ChatAlert);
+	CHECK(DecodeMessage(alertPacket, alert) && alert.m_Requester == "alice");
+
+	bob.Send(EncodeMessage(ChatAlertResponseMsg{ "bob", "alice", true }));
+	CHECK(alice.WaitFor(PacketType::ChatResponse) == "bob:0");
+
+	alice.Send(PacketType::Message, "alice:hello there");
+	UserChatMsg received;
+	Packet receivedPacket = WaitForPacket(bob, PacketType::UserMessage);
+	CHECK(DecodeMessage(receivedPacket, received) && received.m_User == aliceInfo.m_ID && received.m_Text == "hello there");
+
+	bob.Send(EncodeMessage(UserChatMsg{ aliceInfo.m_ID, "hi alice" }));
+	CHECK(alice.WaitFor(PacketType::Message) == "hi alice");
+
+	alice.Send(PacketType::LeaveConvo, "alice");
+	WaitForPacket(bob, PacketType::LeaveConvo);
+
+	alice.Send(PacketType::ClientExit, "");
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	alice.Close();
+	bob.Disconnect();
+	server.Stop();
+}
\ No newline at end of file
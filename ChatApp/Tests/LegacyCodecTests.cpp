@@ -0,0 +1,78 @@
+#include "Test.h"
+#include "../Networking/LegacyCodec.h"
+
+//The bodies below are what the version 1 client and server put on the wire, byte for byte
+
+static Packet RawPacket(PacketType type, std::string_view body) {
+	return LegacyStringPacket(type, { body });
+}
+
+static std::string EncodedBody(const Packet& typed, LegacyDirection direction) {
+	Packet legacy;
+	CHECK(EncodeLegacy(typed, direction, legacy));
+	CHECK(legacy.m_Header.m_ID == typed.m_Header.m_ID && legacy.m_Header.m_Size == legacy.m_Body.size());
+	return std::string(LegacyString(legacy));
+}
+
+TEST(LegacyRequestsFromOldClientsDecode) {
+	Packet packet;
+	ChatRequestMsg request;
+	CHECK(DecodeLegacy(RawPacket(PacketType::ChatRequest, "bob"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, request) && request.m_Receiver == "bob");
+
+	ChatMsg chat;
+	CHECK(DecodeLegacy(RawPacket(PacketType::Message, "alice:hello there: again"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, chat) && chat.m_Sender == "alice" && chat.m_Text == "hello there: again");
+
+	ChatAlertResponseMsg response;
+	CHECK(DecodeLegacy(RawPacket(PacketType::ChatAlertResponse, "bob:alice:t"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, response) && response.m_Receiver == "bob" && response.m_Initiator == "alice" && response.m_Accepted);
+	CHECK(DecodeLegacy(RawPacket(PacketType::ChatAlertResponse, "bob:alice:f"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, response) && !response.m_Accepted);
+
+	LeaveConvoMsg leave;
+	CHECK(DecodeLegacy(RawPacket(PacketType::LeaveConvo, "alice"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, leave) && leave.m_User == "alice");
+	CHECK(DecodeLegacy(RawPacket(PacketType::LeaveConvo, ""), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, leave) && leave.m_User.empty());
+
+	ChangePasswordMsg password;
+	CHECK(DecodeLegacy(RawPacket(PacketType::ChangePassword, "alice#secret"), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, password) && password.m_User == "alice" && password.m_NewPassword == "secret");
+
+	ClientExitMsg exit;
+	CHECK(DecodeLegacy(Packet(PacketType::ClientExit), LegacyDirection::ClientToServer, packet));
+	CHECK(DecodeMessage(packet, exit));
+}
+
+TEST(LegacyRepliesMatchOldServer) {
+	CHECK(EncodedBody(EncodeMessage(ChatAlertMsg{ "alice" }), LegacyDirection::ServerToClient) == "alice");
+	CHECK(EncodedBody(EncodeMessage(ChatResponseMsg{ "bob", 0 }), LegacyDirection::ServerToClient) == "bob:0");
+	CHECK(EncodedBody(EncodeMessage(ChatResponseMsg{ "bob", 4 }), LegacyDirection::ServerToClient) == "bob:4");
+	CHECK(EncodedBody(EncodeMessage(ChatMsg{ "alice", "hello there" }), LegacyDirection::ServerToClient) == "hello there");
+	CHECK(EncodedBody(EncodeMessage(LeaveConvoMsg{ "alice" }), LegacyDirection::ServerToClient).empty());
+	CHECK(EncodedBody(EncodeMessage(OnlineListMsg{ "alice - Open\n" }), LegacyDirection::ServerToClient) == "alice - Open\n");
+
+	//The reason went out as a memcpy'd int
+	int32_t reason = 3;
+	std::string rejected = EncodedBody(EncodeMessage(ServerRejectMsg{ reason }), LegacyDirection::ServerToClient);
+	CHECK(rejected.size() == sizeof(reason) && std::memcmp(rejected.data(), &reason, sizeof(reason)) == 0);
+}
+
+TEST(LegacyRequestsToOldServerEncode) {
+	CHECK(EncodedBody(EncodeMessage(ChatMsg{ "alice", "hello there" }), LegacyDirection::ClientToServer) == "alice:hello there");
+	CHECK(EncodedBody(EncodeMessage(ChatAlertResponseMsg{ "bob", "alice", true }), LegacyDirection::ClientToServer) == "bob:alice:t");
+	CHECK(EncodedBody(EncodeMessage(ChangePasswordMsg{ "alice", "secret" }), LegacyDirection::ClientToServer) == "alice#secret");
+	CHECK(EncodedBody(EncodeMessage(LeaveConvoMsg{ "alice" }), LegacyDirection::ClientToServer) == "alice");
+}
+
+TEST(LegacyRejectsWhatVersionOneNeverHad) {
+	Packet packet;
+	CHECK(!DecodeLegacy(RawPacket(PacketType::Message, "no separator"), LegacyDirection::ClientToServer, packet));
+	CHECK(!DecodeLegacy(RawPacket(PacketType::ChatAlertResponse, "bob"), LegacyDirection::ClientToServer, packet));
+	CHECK(!DecodeLegacy(RawPacket(PacketType::ChatResponse, "bob:"), LegacyDirection::ServerToClient, packet));
+	CHECK(!DecodeLegacy(RawPacket(PacketType::UserMessage, "x"), LegacyDirection::ClientToServer, packet));
+	CHECK(!DecodeLegacy(RawPacket(PacketType::AccountInfo, ""), LegacyDirection::ClientToServer, packet));
+	CHECK(!EncodeLegacy(EncodeMessage(UserInfoMsg{ static_cast<UserID>(1), "alice" }), LegacyDirection::ServerToClient, packet));
+	CHECK(!EncodeLegacy(EncodeMessage(ChatResponseMsg{ "bob", 10 }), LegacyDirection::ServerToClient, packet));
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include "../Networking/Server.h"
+#include "../Networking/Client.h"
+#include "Test.h"
+#include <filesystem>
+
+constexpr uint16_t TEST_PORT = 3917;
+
+//Tests run in a scratch directory with an empty account file, so every test can register the same usernames
+inline void ResetServerFiles() {
+	std::filesystem::create_directories("Accounts");
+	std::filesystem::create_directories("ServerLog");
+	std::ofstream("Accounts/AccStorage.txt", std::ios_base::trunc);
+}
+
+//Skips everything else the client was sent until a packet of the given type shows up
+inline Packet WaitForPacket(Client& client, PacketType type, std::chrono::milliseconds timeout = std::chrono::milliseconds(3000)) {
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	OwnedPacket owned;
+
+	while (std::chrono::steady_clock::now() < deadline) {
+		while (client.Incoming().TryPopFront(owned)) {
+			if (owned.m_Packet.m_Header.m_ID == type) {
+				return std::move(owned.m_Packet);
+			}
+		}
+
+		client.Incoming().WaitFor(std::chrono::milliseconds(10));
+	}
+
+	throw TestFailure{ "Timed out waiting for packet type " + std::to_string(static_cast<int>(type)) };
+}
+
+//Logs both users in and puts them in a conversation, the server runs its handlers on the context
+struct ChatPair {
+	ChatPair() : m_Server(TEST_PORT, DispatchMode::Strand) {
+		ResetServerFiles();
+		CHECK(m_Server.Start());
+
+		m_First.Connect("127.0.0.1", TEST_PORT, "alice", "pw", 2);
+		WaitForPacket(m_First, PacketType::ServerAccept);
+		m_Second.Connect("127.0.0.1", TEST_PORT, "bob", "pw", 2);
+		WaitForPacket(m_Second, PacketType::ServerAccept);
+
+		m_First.Send(EncodeMessage(ChatRequestMsg{ "bob" }));
+		WaitForPacket(m_Second, PacketType::ChatAlert);
+		m_Second.Send(EncodeMessage(ChatAlertResponseMsg{ "bob", "alice", true }));
+
+		UserInfoMsg info;
+		Packet infoPacket = WaitForPacket(m_First, PacketType::UserInfo);
+		CHECK(DecodeMessage(infoPacket, info));
+		m_SecondID = info.m_ID;
+		WaitForPacket(m_First, PacketType::ChatResponse);
+	}
+
+	~ChatPair() {
+		m_First.Disconnect();
+		m_Second.Disconnect();
+		m_Server.Stop();
+	}
+
+	Server m_Server;
+	Client m_First, m_Second;
+	UserID m_SecondID = UserID::None;
+};
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "NetTest.h"
+#include <set>
+
+static void ApplySnapshot(Client& client) {
+	PresenceSnapshotMsg snapshot;
+	Packet packet = WaitForPacket(client, PacketType::PresenceSnapshot);
+	CHECK(DecodeMessage(packet, snapshot));
+	client.ApplyPresenceSnapshot(snapshot);
+}
+
+//The next delta the server sends, applied or not
+static bool ApplyDelta(Client& client, PresenceEntry& changed, PresenceChange& change) {
+	PresenceDeltaMsg delta;
+	Packet packet = WaitForPacket(client, PacketType::PresenceDelta);
+	CHECK(DecodeMessage(packet, delta));
+	change = static_cast<PresenceChange>(delta.m_Change);
+	return client.ApplyPresenceDelta(delta, changed);
+}
+
+static std::set<std::string> Online(const Client& client) {
+	std::set<std::string> users;
+	for (const auto& entry : client.getPresence()) {
+		users.insert(entry.second.m_User);
+	}
+
+	return users;
+}
+
+TEST(PresenceJoinLeaveRejoin) {
+	ResetServerFiles();
+	Server server(TEST_PORT, DispatchMode::Strand);
+	CHECK(server.Start());
+
+	Client alice;
+	alice.Connect("127.0.0.1", TEST_PORT, "alice", "pw", 2);
+	WaitForPacket(alice, PacketType::ServerAccept);
+	ApplySnapshot(alice);
+	CHECK(Online(alice) == std::set<std::string>({ "alice" }));
+
+	PresenceEntry changed;
+	PresenceChange change;
+	{
+		Client bob;
+		bob.Connect("127.0.0.1", TEST_PORT, "bob", "pw", 2);
+		WaitForPacket(bob, PacketType::ServerAccept);
+		CHECK(ApplyDelta(alice, changed, change) && change == PresenceChange::Join && changed.m_User == "bob");
+		CHECK(Online(alice) == std::set<std::string>({ "alice", "bob" }));
+
+		bob.Send(EncodeMessage(ClientExitMsg{}));
+		CHECK(ApplyDelta(alice, changed, change) && change == PresenceChange::Leave && changed.m_User == "bob");
+		CHECK(Online(alice) == std::set<std::string>({ "alice" }) && alice.FindUserID("bob") == UserID::None);
+	}
+
+	Client bob;
+	bob.Connect("127.0.0.1", TEST_PORT, "bob", "pw", 1);
+	WaitForPacket(bob, PacketType::ServerAccept);
+	CHECK(ApplyDelta(alice, changed, change) && change == PresenceChange::Join && changed.m_User == "bob");
+	CHECK(Online(alice) == std::set<std::string>({ "alice", "bob" }) && alice.FindUserID("bob") != UserID::None);
+	CHECK(alice.isPresenceSynced());
+
+	alice.Disconnect();
+	bob.Disconnect();
+	server.Stop();
+}
+
+//A delta that skips a version means one went missing, the client asks for a snapshot and goes by that instead
+TEST(PresenceGapResyncs) {
+	ResetServerFiles();
+	Server server(TEST_PORT, DispatchMode::Strand);
+	CHECK(server.Start());
+
+	Client alice, bob, carol;
+	alice.Connect("127.0.0.1", TEST_PORT, "alice", "pw", 2);
+	WaitForPacket(alice, PacketType::ServerAccept);
+	ApplySnapshot(alice);
+
+	bob.Connect("127.0.0.1", TEST_PORT, "bob", "pw", 2);
+	WaitForPacket(bob, PacketType::ServerAccept);
+	PresenceDeltaMsg bobJoined;
+	Packet bobJoinedPacket = WaitForPacket(alice, PacketType::PresenceDelta); //Held back, as if it were lost
+	CHECK(DecodeMessage(bobJoinedPacket, bobJoined));
+
+	carol.Connect("127.0.0.1", TEST_PORT, "carol", "pw", 2);
+	WaitForPacket(carol, PacketType::ServerAccept);
+	PresenceEntry changed;
+	PresenceChange change;
+	CHECK(!ApplyDelta(alice, changed, change));
+	CHECK(!alice.isPresenceSynced());
+
+	//Nothing is applied while waiting on the snapshot, even the delta that was missing
+	CHECK(!alice.ApplyPresenceDelta(bobJoined, changed));
+
+	ApplySnapshot(alice);
+	CHECK(alice.isPresenceSynced());
+	CHECK(Online(alice) == std::set<std::string>({ "alice", "bob", "carol" }));
+
+	//The snapshot already covers the late delta, so it's dropped as stale
+	CHECK(!alice.ApplyPresenceDelta(bobJoined, changed));
+	CHECK(alice.isPresenceSynced());
+
+	carol.Send(EncodeMessage(ClientExitMsg{}));
+	CHECK(ApplyDelta(alice, changed, change) && change == PresenceChange::Leave && changed.m_User == "carol");
+	CHECK(Online(alice) == std::set<std::string>({ "alice", "bob" }));
+
+	alice.Disconnect();
+	bob.Disconnect();
+	carol.Disconnect();
+	server.Stop();
+}
\ No newline at end of file
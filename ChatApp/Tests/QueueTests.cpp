@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "../Networking/RingQueue.h"
+#include "../Networking/MPSCQueue.h"
+#include "../Networking/MPMCQueue.h"
+#include <algorithm>
+#include <thread>
+
+//Pops and pushes go round the ring a few times before it has to grow, and the growth keeps the order
+TEST(RingQueueWrapsAndGrows) {
+	RingQueue<int> queue(4);
+	int pushed = 0, popped = 0;
+
+	for (int lap = 0; lap < 10; lap++) {
+		queue.PushBack(pushed++);
+		queue.PushBack(pushed++);
+		queue.PushBack(pushed++);
+		CHECK(queue.PopFront() == popped++);
+		CHECK(queue.PopFront() == popped++);
+	}
+	CHECK(queue.count() == 10);
+
+	for (int i = 0; i < 100; i++) {
+		queue.PushBack(pushed++);
+	}
+
+	CHECK(queue.count() == 110 && queue.Front() == popped);
+	for (size_t i = 0; i < queue.count(); i++) {
+		CHECK(queue.At(i) == popped + static_cast<int>(i));
+	}
+
+	CHECK(queue.Erase(1) == popped + 1);
+	CHECK(queue.PopFront() == popped);
+	popped += 2;
+
+	while (!queue.isEmpty()) {
+		CHECK(queue.PopFront() == popped++);
+	}
+	CHECK(popped == pushed);
+}
+
+//Every producer's items arrive exactly once and in the order that producer pushed them
+TEST(MPSCQueueDeliversEachItemOnce) {
+	constexpr int PRODUCERS = 4, ITEMS = 20000;
+	MPSCQueue<int> queue;
+
+	std::vector<std::thread> producers;
+	for (int producer = 0; producer < PRODUCERS; producer++) {
+		producers.emplace_back([&queue, producer]() {
+			for (int i = 0; i < ITEMS; i++) {
+				queue.Push(producer * ITEMS + i);
+			}
+		});
+	}
+
+	std::vector<int> next(PRODUCERS, 0);
+	int received = 0, item;
+	bool ordered = true;
+	while (received < PRODUCERS * ITEMS) {
+		if (!queue.Pop(item)) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		int producer = item / ITEMS;
+		ordered = ordered && item % ITEMS == next[producer];
+		next[producer]++;
+		received++;
+	}
+
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+
+	CHECK(ordered);
+	CHECK(!queue.Pop(item));
+	CHECK(next == std::vector<int>(PRODUCERS, ITEMS));
+}
+
+TEST(MPMCQueueFullAndEmpty) {
+	MPMCQueue<int> queue(4);
+	int item = -1;
+	CHECK(queue.isEmpty() && !queue.TryPopFront(item) && item == -1);
+
+	for (int i = 0; i < 4; i++) {
+		CHECK(queue.TryPushBack(int(i)));
+	}
+
+	CHECK(!queue.TryPushBack(4) && queue.count() == 4);
+	CHECK(queue.TryPopFront(item) && item == 0);
+	CHECK(queue.TryPushBack(4));
+
+	for (int i = 1; i <= 4; i++) {
+		CHECK(queue.TryPopFront(item) && item == i);
+	}
+	CHECK(queue.isEmpty() && !queue.TryPopFront(item));
+
+	//A push into a full queue leaves the item with the caller
+	MPMCQueue<std::unique_ptr<int>> pointers(2);
+	std::unique_ptr<int> kept = std::make_unique<int>(7);
+	CHECK(pointers.TryPushBack(std::make_unique<int>(1)) && pointers.TryPushBack(std::make_unique<int>(2)));
+	CHECK(!pointers.TryPushBack(std::move(kept)) && kept && *kept == 7);
+}
+
+//Several producers and consumers on a queue small enough to keep filling up, every item comes out exactly once
+TEST(MPMCQueueDeliversEachItemOnce) {
+	constexpr int PRODUCERS = 4, CONSUMERS = 4, ITEMS = 20000;
+	MPMCQueue<int> queue(64);
+	std::vector<std::atomic<int>> seen(PRODUCERS * ITEMS);
+	std::atomic<int> received{ 0 };
+
+	std::vector<std::thread> threads;
+	for (int producer = 0; producer < PRODUCERS; producer++) {
+		threads.emplace_back([&queue, producer]() {
+			for (int i = 0; i < ITEMS; i++) {
+				queue.PushBack(producer * ITEMS + i);
+			}
+		});
+	}
+
+	for (int consumer = 0; consumer < CONSUMERS; consumer++) {
+		threads.emplace_back([&queue, &seen, &received]() {
+			int item;
+			while (received < PRODUCERS * ITEMS) {
+				if (queue.TryPopFront(item)) {
+					seen[item]++;
+					received++;
+				}
+				else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	CHECK(received == PRODUCERS * ITEMS && queue.isEmpty());
+	CHECK(std::all_of(seen.begin(), seen.end(), [](const std::atomic<int>& count) { return count == 1; }));
+}
\ No newline at end of file
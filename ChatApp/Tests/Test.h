@@ -0,0 +1,37 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Bare bones test runner. TEST registers the test before main() runs, CHECK ends the test on the first failure
+struct TestFailure {
+	std::string m_What;
+};
+
+struct TestCase {
+	const char* m_Name;
+	void (*m_Body)();
+};
+
+inline std::vector<TestCase>& TestRegistry() {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+struct TestRegistrar {
+	TestRegistrar(const char* name, void (*body)()) {
+		TestRegistry().push_back({ name, body });
+	}
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			throw TestFailure{ std::string(__FILE__) + ":" + std::to_string(__LINE__) + " CHECK(" #condition ") failed" }; \
+		} \
+	} while (false)
@@ -0,0 +1,37 @@
+#include "Test.h"
+#include <algorithm>
+#include <filesystem>
+
+//Runs every registered test, or only the ones named on the command line. Returns the number that failed
+int main(int argc, char* argv[]) {
+	std::vector<std::string> selected(argv + 1, argv + argc);
+
+	//The server writes its log and account files relative to the working directory, keep them out of the source tree
+	std::filesystem::path scratch = std::filesystem::temp_directory_path() / "ChatAppTests";
+	std::filesystem::create_directories(scratch);
+	std::filesystem::current_path(scratch);
+
+	int failed = 0, ran = 0;
+	for (const TestCase& test : TestRegistry()) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), test.m_Name) == selected.end()) {
+			continue;
+		}
+
+		ran++;
+		try {
+			test.m_Body();
+			std::cout << "[PASS] " << test.m_Name << std::endl;
+		}
+		catch (const TestFailure& failure) {
+			failed++;
+			std::cout << "[FAIL] " << test.m_Name << ": " << failure.m_What << std::endl;
+		}
+		catch (const std::exception& e) {
+			failed++;
+			std::cout << "[FAIL] " << test.m_Name << ": exception thrown: " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << ran - failed << "/" << ran << " tests passed" << std::endl;
+	return failed;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "Test.h"
+#include "../Networking/WireHeader.h"
+
+static std::vector<uint8_t> Varint(uint64_t value) {
+	std::vector<uint8_t> encoded(MAX_VARINT_BYTES);
+	encoded.resize(EncodeVarint(value, encoded.data()));
+	return encoded;
+}
+
+TEST(VarintBoundaries) {
+	const std::pair<uint64_t, size_t> cases[] = {
+		{ 0, 1 }, { 127, 1 }, { 128, 2 }, { 16383, 2 }, { 16384, 3 }, { UINT32_MAX, 5 }, { UINT64_MAX, MAX_VARINT_BYTES }
+	};
+
+	for (const auto& [value, length] : cases) {
+		std::vector<uint8_t> encoded = Varint(value);
+		CHECK(encoded.size() == length);
+
+		size_t offset = 0;
+		uint64_t decoded = 0;
+		CHECK(ReadVarint(encoded.data(), encoded.size(), offset, decoded) && decoded == value && offset == length);
+	}
+
+	CHECK(Varint(127) == std::vector<uint8_t>({ 0x7F }));
+	CHECK(Varint(128) == std::vector<uint8_t>({ 0x80, 0x01 }));
+}
+
+TEST(VarintRejectsTruncatedAndOverlong) {
+	std::vector<uint8_t> encoded = Varint(16384);
+	size_t offset = 0;
+	uint64_t value;
+	CHECK(!ReadVarint(encoded.data(), encoded.size() - 1, offset, value));
+
+	//Never ends within the longest a 64 bit value can take
+	std::vector<uint8_t> overlong(MAX_VARINT_BYTES + 1, 0x80);
+	overlong.back() = 0x01;
+	offset = 0;
+	CHECK(!ReadVarint(overlong.data(), overlong.size(), offset, value));
+}
+
+static HeaderResult Decode(HeaderFormat format, const std::vector<uint8_t>& data, PacketHeader& header, size_t& headerLength) {
+	return DecodeHeader(format, data.data(), data.size(), header, headerLength);
+}
+
+TEST(CompactHeaderSizes) {
+	const std::pair<uint32_t, size_t> cases[] = {
+		{ 0, 2 }, { 127, 2 }, { 128, 3 }, { 16383, 3 }, { 16384, 4 }, { UINT32_MAX, MAX_HEADER_SIZE - 2 }
+	};
+
+	for (const auto& [size, length] : cases) {
+		PacketHeader header{ PacketType::Message, size };
+		std::vector<uint8_t> encoded(MAX_HEADER_SIZE);
+		encoded.resize(EncodeHeader(HeaderFormat::Compact, header, encoded.data()));
+		CHECK(encoded.size() == length);
+
+		PacketHeader decoded{ PacketType::OnlineList };
+		size_t headerLength = 0;
+		CHECK(Decode(HeaderFormat::Compact, encoded, decoded, headerLength) == HeaderResult::Complete);
+		CHECK(decoded.m_ID == PacketType::Message && decoded.m_Size == size && decoded.m_Flags == 0 && headerLength == length);
+	}
+}
+
+//Every prefix of a header is Incomplete, whichever read it gets split across
+TEST(HeaderSplitAcrossReads) {
+	for (HeaderFormat format : { HeaderFormat::Compact, HeaderFormat::Legacy }) {
+		PacketHeader header{ PacketType::OnlineList, 300000 };
+		std::vector<uint8_t> encoded(MAX_HEADER_SIZE);
+		encoded.resize(EncodeHeader(format, header, encoded.data()));
+
+		PacketHeader decoded;
+		size_t headerLength = 0;
+		for (size_t split = 0; split < encoded.size(); split++) {
+			CHECK(Decode(format, std::vector<uint8_t>(encoded.begin(), encoded.begin() + split), decoded, headerLength) == HeaderResult::Incomplete);
+		}
+
+		encoded.push_back(0xAB); //The start of the body doesn't change anything
+		CHECK(Decode(format, encoded, decoded, headerLength) == HeaderResult::Complete);
+		CHECK(decoded.m_Size == 300000 && headerLength == encoded.size() - 1);
+	}
+}
+
+TEST(CompactHeaderRejectsOverlongSize) {
+	PacketHeader header;
+	size_t headerLength = 0;
+	uint8_t type = static_cast<uint8_t>(PacketType::Message);
+
+	//Still going after the 5 bytes any 32 bit size fits in
+	CHECK(Decode(HeaderFormat::Compact, { type, 0x80, 0x80, 0x80, 0x80 }, header, headerLength) == HeaderResult::Incomplete);
+	CHECK(Decode(HeaderFormat::Compact, { type, 0x80, 0x80, 0x80, 0x80, 0x80 }, header, headerLength) == HeaderResult::Invalid);
+
+	//Ends in time but is bigger than a 32 bit size
+	CHECK(Decode(HeaderFormat::Compact, { type, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F }, header, headerLength) == HeaderResult::Invalid);
+	CHECK(Decode(HeaderFormat::Compact, { type, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F }, header, headerLength) == HeaderResult::Complete);
+	CHECK(header.m_Size == UINT32_MAX);
+}
+
+//The flag shares the type byte, it comes back out separately in both formats
+TEST(HeaderCompressedFlag) {
+	for (HeaderFormat format : { HeaderFormat::Compact, HeaderFormat::Legacy }) {
+		PacketHeader header{ PacketType::OnlineList, 600, HEADER_FLAG_COMPRESSED };
+		std::vector<uint8_t> encoded(MAX_HEADER_SIZE);
+		encoded.resize(EncodeHeader(format, header, encoded.data()));
+		CHECK((encoded[0] & HEADER_FLAG_COMPRESSED) != 0);
+
+		PacketHeader decoded;
+		size_t headerLength = 0;
+		CHECK(Decode(format, encoded, decoded, headerLength) == HeaderResult::Complete);
+		CHECK(decoded.m_ID == PacketType::OnlineList && decoded.m_Flags == HEADER_FLAG_COMPRESSED && decoded.m_Size == 600);
+	}
+}
\ No newline at end of file